@@ -23,28 +23,2873 @@
  **/
 
 #include <QMutex>
+#include <QReadWriteLock>
+#include <QLocale>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef LQO_ZLIB
+#include <zlib.h>
+#endif
 
 #include "../deps/lqtutils/lqtutils_autoexec.h"
 
-#include "lserializer.h"
+#include "lserializer.h"
+
+Q_LOGGING_CATEGORY(lserializer, "lserializer")
+
+namespace lqo {
+
+static AllocationCounter s_allocationCounter = nullptr;
+
+void setAllocationCounter(AllocationCounter counter)
+{
+    s_allocationCounter = counter;
+}
+
+AllocationCounter allocationCounter()
+{
+    return s_allocationCounter;
+}
+
+Counters& Counters::operator+=(const Counters& other)
+{
+    allocations += other.allocations;
+    instantiations += other.instantiations;
+    variantConstructions += other.variantConstructions;
+    propertyReads += other.propertyReads;
+    propertyWrites += other.propertyWrites;
+    methodInvocations += other.methodInvocations;
+    return *this;
+}
+
+void InstrumentationStats::clear()
+{
+    counters = Counters();
+    perMetaObject.clear();
+}
+
+InstrumentationStats& InstrumentationStats::operator+=(const InstrumentationStats& other)
+{
+    counters += other.counters;
+    for (auto it = other.perMetaObject.constBegin(), end = other.perMetaObject.constEnd(); it != end; ++it)
+        perMetaObject[it.key()] += it.value();
+    return *this;
+}
+
+void Instrumentation::reset()
+{
+    m_lastCall.clear();
+    m_total.clear();
+}
+
+void Instrumentation::count(const QMetaObject* metaObject, quint64 Counters::* counter)
+{
+    m_lastCall.counters.*counter += 1;
+    m_lastCall.perMetaObject[metaObject].*counter += 1;
+}
+
+InstrumentationCall::InstrumentationCall(Instrumentation& instrumentation) :
+    m_instrumentation(instrumentation)
+{
+    if (m_instrumentation.m_depth++ > 0)
+        return;
+    m_instrumentation.m_lastCall.clear();
+    m_instrumentation.m_allocationsAtStart = s_allocationCounter ? s_allocationCounter() : 0;
+}
+
+InstrumentationCall::~InstrumentationCall()
+{
+    if (--m_instrumentation.m_depth > 0)
+        return;
+    if (s_allocationCounter)
+        m_instrumentation.m_lastCall.counters.allocations = s_allocationCounter() - m_instrumentation.m_allocationsAtStart;
+    m_instrumentation.m_total += m_instrumentation.m_lastCall;
+}
+
+TypeStats& TypeStats::operator+=(const TypeStats& other)
+{
+    nsecs += other.nsecs;
+    objects += other.objects;
+    bytesIn += other.bytesIn;
+    bytesOut += other.bytesOut;
+    warnings += other.warnings;
+    return *this;
+}
+
+QVariantMap TypeStats::toVariantMap() const
+{
+    return QVariantMap {
+        { QStringLiteral("nsecs"), nsecs },
+        { QStringLiteral("objects"), objects },
+        { QStringLiteral("bytesIn"), bytesIn },
+        { QStringLiteral("bytesOut"), bytesOut },
+        { QStringLiteral("warnings"), warnings }
+    };
+}
+
+void StatsCollector::record(const QMetaObject* metaObject, const TypeStats& stats)
+{
+    Shard* shard = localShard();
+    QMutexLocker locker(&shard->mutex);
+    shard->stats[metaObject] += stats;
+}
+
+void StatsCollector::recordBytesIn(const QMetaObject* metaObject, quint64 bytes)
+{
+    TypeStats stats;
+    stats.bytesIn = bytes;
+    record(metaObject, stats);
+}
+
+void StatsCollector::recordBytesOut(const QMetaObject* metaObject, quint64 bytes)
+{
+    TypeStats stats;
+    stats.bytesOut = bytes;
+    record(metaObject, stats);
+}
+
+void StatsCollector::recordWarning(const QMetaObject* metaObject)
+{
+    TypeStats stats;
+    stats.warnings = 1;
+    record(metaObject, stats);
+}
+
+QHash<const QMetaObject*, TypeStats> StatsCollector::snapshot() const
+{
+    QHash<const QMetaObject*, TypeStats> ret;
+    QMutexLocker locker(&m_mutex);
+    for (const QSharedPointer<Shard>& shard : m_shards) {
+        QMutexLocker shardLocker(&shard->mutex);
+        for (auto it = shard->stats.constBegin(), end = shard->stats.constEnd(); it != end; ++it)
+            ret[it.key()] += it.value();
+    }
+
+    return ret;
+}
+
+QVariantMap StatsCollector::toVariantMap() const
+{
+    QVariantMap ret;
+    const QHash<const QMetaObject*, TypeStats> stats = snapshot();
+    for (auto it = stats.constBegin(), end = stats.constEnd(); it != end; ++it) {
+        const QString className = it.key() ? QString(it.key()->className()) : QString();
+        ret.insert(className, it.value().toVariantMap());
+    }
+
+    return ret;
+}
+
+QJsonObject StatsCollector::toJson() const
+{
+    return QJsonObject::fromVariantMap(toVariantMap());
+}
+
+void StatsCollector::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    for (const QSharedPointer<Shard>& shard : m_shards) {
+        QMutexLocker shardLocker(&shard->mutex);
+        shard->stats.clear();
+    }
+}
+
+StatsCollector::Shard* StatsCollector::localShard()
+{
+    if (m_localShard.hasLocalData())
+        return m_localShard.localData().data();
+
+    QSharedPointer<Shard> shard(new Shard);
+    m_localShard.setLocalData(shard);
+
+    QMutexLocker locker(&m_mutex);
+    m_shards.append(shard);
+    return shard.data();
+}
+
+StatsScope::StatsScope(StatsCollector* collector, const QMetaObject* metaObject, StatsScope** current) :
+    m_collector(collector)
+  , m_metaObject(metaObject)
+  , m_current(current)
+  , m_parent(nullptr)
+  , m_childNsecs(0)
+{
+    if (!m_collector)
+        return;
+    m_parent = *m_current;
+    *m_current = this;
+    m_timer.start();
+}
+
+StatsScope::~StatsScope()
+{
+    if (!m_collector)
+        return;
+
+    const qint64 elapsed = m_timer.nsecsElapsed();
+    TypeStats stats;
+    stats.nsecs = elapsed - m_childNsecs;
+    stats.objects = 1;
+    m_collector->record(m_metaObject, stats);
+
+    if (m_parent)
+        m_parent->m_childNsecs += elapsed;
+    *m_current = m_parent;
+}
+
+// Incremented by every registration, so cached plans can be made again.
+static QBasicAtomicInt s_registryGeneration = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+int registry_generation()
+{
+    return s_registryGeneration.loadAcquire();
+}
+
+Q_GLOBAL_STATIC(QReadWriteLock, s_gadgetArrayKernelsLock)
+typedef QHash<int, GadgetArrayKernel> GadgetArrayKernels;
+Q_GLOBAL_STATIC(GadgetArrayKernels, s_gadgetArrayKernels)
+static QBasicAtomicInt s_gadgetArrayTypes = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+void register_gadget_array_kernel(int metaTypeId, const GadgetArrayKernel& kernel)
+{
+    QWriteLocker locker(s_gadgetArrayKernelsLock());
+    s_gadgetArrayKernels->insert(metaTypeId, kernel);
+    s_gadgetArrayTypes.ref();
+    s_registryGeneration.ref();
+}
+
+bool gadget_array_kernel(int metaTypeId, GadgetArrayKernel* kernel)
+{
+    if (!s_gadgetArrayTypes.loadAcquire())
+        return false;
+
+    QReadLocker locker(s_gadgetArrayKernelsLock());
+    GadgetArrayKernels::const_iterator it = s_gadgetArrayKernels->constFind(metaTypeId);
+    if (it == s_gadgetArrayKernels->constEnd())
+        return false;
+
+    *kernel = it.value();
+    return true;
+}
+
+RawJson RawJson::fromJson(const QByteArray& json)
+{
+    RawJson ret;
+    ret.m_json = json;
+    return ret;
+}
+
+QJsonValue RawJson::value() const
+{
+    if (m_hasValue || m_json.isEmpty())
+        return m_value;
+
+    // Wrap the value in an array, so that any JSON value can be parsed.
+    QByteArray array;
+    array.reserve(m_json.size() + 2);
+    array.append('[').append(m_json).append(']');
+    return QJsonDocument::fromJson(array).array().at(0);
+}
+
+QByteArray RawJson::toJson() const
+{
+    if (!m_hasValue)
+        return m_json;
+
+    const QByteArray array = QJsonDocument(QJsonArray() << m_value).toJson(QJsonDocument::Compact);
+    return array.mid(1, array.size() - 2);
+}
+
+bool RawJson::operator==(const RawJson& other) const
+{
+    if (!m_hasValue && !other.m_hasValue)
+        return m_json == other.m_json;
+    return value() == other.value();
+}
+
+void JsonWriter::beginObject()
+{
+    prefix();
+    m_buffer->append('{');
+    m_hasElements.append(false);
+}
+
+void JsonWriter::endObject()
+{
+    m_hasElements.removeLast();
+    m_buffer->append('}');
+}
+
+void JsonWriter::beginArray()
+{
+    prefix();
+    m_buffer->append('[');
+    m_hasElements.append(false);
+}
+
+void JsonWriter::endArray()
+{
+    m_hasElements.removeLast();
+    m_buffer->append(']');
+}
+
+void JsonWriter::writeKey(const char* key)
+{
+    prefix();
+    writeString(QByteArray::fromRawData(key, int(qstrlen(key))));
+    m_buffer->append(':');
+    m_afterKey = true;
+}
+
+void JsonWriter::writeKey(const QString& key)
+{
+    prefix();
+    writeString(key.toUtf8());
+    m_buffer->append(':');
+    m_afterKey = true;
+}
+
+void JsonWriter::writeValue(const QJsonValue& value)
+{
+    switch (value.type()) {
+    case QJsonValue::Null:
+    case QJsonValue::Undefined:
+        prefix();
+        m_buffer->append("null");
+        break;
+    case QJsonValue::Bool:
+        prefix();
+        m_buffer->append(value.toBool() ? "true" : "false");
+        break;
+    case QJsonValue::Double: {
+        prefix();
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        // QJsonValue keeps 64 bit integers on Qt 6: the value is an integer if no
+        // default is used.
+        const qint64 i = value.toInteger(0);
+        if (i == value.toInteger(1)) {
+            m_buffer->append(QByteArray::number(i));
+            break;
+        }
+#endif
+        const double d = value.toDouble();
+        if (!std::isfinite(d))
+            m_buffer->append("null");
+        else if (d == std::floor(d) && std::fabs(d) < 9007199254740992.0)
+            m_buffer->append(QByteArray::number(qint64(d)));
+        else
+            m_buffer->append(QByteArray::number(d, 'g', QLocale::FloatingPointShortest));
+        break;
+    }
+    case QJsonValue::String:
+        prefix();
+        writeString(value.toString().toUtf8());
+        break;
+    case QJsonValue::Array: {
+        beginArray();
+        const QJsonArray array = value.toArray();
+        for (const QJsonValue& element : array)
+            writeValue(element);
+        endArray();
+        break;
+    }
+    case QJsonValue::Object: {
+        beginObject();
+        const QJsonObject object = value.toObject();
+        for (QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it) {
+            writeKey(it.key());
+            writeValue(it.value());
+        }
+        endObject();
+        break;
+    }
+    }
+}
+
+///
+/// \brief is_valid_utf8 returns whether utf8 is well formed: no truncated sequences,
+/// overlong forms, surrogates or code points above U+10FFFF.
+///
+static bool is_valid_utf8(const QByteArray& utf8)
+{
+    const uchar* p = reinterpret_cast<const uchar*>(utf8.constData());
+    const uchar* end = p + utf8.size();
+    while (p != end) {
+        const uchar c = *p++;
+        if (c < 0x80)
+            continue;
+
+        int continuation;
+        uint codePoint;
+        uint min;
+        if ((c & 0xe0) == 0xc0) {
+            continuation = 1;
+            codePoint = c & 0x1f;
+            min = 0x80;
+        }
+        else if ((c & 0xf0) == 0xe0) {
+            continuation = 2;
+            codePoint = c & 0x0f;
+            min = 0x800;
+        }
+        else if ((c & 0xf8) == 0xf0) {
+            continuation = 3;
+            codePoint = c & 0x07;
+            min = 0x10000;
+        }
+        else
+            return false;
+
+        if (end - p < continuation)
+            return false;
+        for (int i = 0; i < continuation; i++) {
+            if ((p[i] & 0xc0) != 0x80)
+                return false;
+            codePoint = (codePoint << 6) | (p[i] & 0x3f);
+        }
+        p += continuation;
+        if (codePoint < min || codePoint > 0x10ffff || (codePoint >= 0xd800 && codePoint < 0xe000))
+            return false;
+    }
+
+    return true;
+}
+
+void JsonWriter::writeUtf8(const QByteArray& utf8)
+{
+    prefix();
+    // Invalid sequences are replaced with U+FFFD, as QString does, so the output is
+    // always valid JSON.
+    if (is_valid_utf8(utf8))
+        writeString(utf8);
+    else
+        writeString(QString::fromUtf8(utf8).toUtf8());
+}
+
+void JsonWriter::writeRaw(const QByteArray& json)
+{
+    prefix();
+    m_buffer->append(json);
+}
+
+void JsonWriter::prefix()
+{
+    if (m_afterKey) {
+        m_afterKey = false;
+        return;
+    }
+
+    if (m_hasElements.isEmpty())
+        return;
+    if (m_hasElements.last())
+        m_buffer->append(',');
+    m_hasElements.last() = true;
+}
+
+void JsonWriter::writeString(const QByteArray& utf8)
+{
+    static const char hex[] = "0123456789abcdef";
+    m_buffer->append('"');
+
+    // Runs of characters that need no escaping are copied at once.
+    const char* run = utf8.constData();
+    const char* end = run + utf8.size();
+    for (const char* p = run; p != end; ++p) {
+        const uchar c = uchar(*p);
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        m_buffer->append(run, int(p - run));
+        run = p + 1;
+        switch (c) {
+        case '"': m_buffer->append("\\\""); break;
+        case '\\': m_buffer->append("\\\\"); break;
+        case '\b': m_buffer->append("\\b"); break;
+        case '\f': m_buffer->append("\\f"); break;
+        case '\n': m_buffer->append("\\n"); break;
+        case '\r': m_buffer->append("\\r"); break;
+        case '\t': m_buffer->append("\\t"); break;
+        default:
+            m_buffer->append("\\u00");
+            m_buffer->append(hex[c >> 4]);
+            m_buffer->append(hex[c & 0xf]);
+        }
+    }
+    m_buffer->append(run, int(end - run));
+    m_buffer->append('"');
+}
+
+StreamSerializer::StreamSerializer(QIODevice* device,
+                                   Mode mode,
+                                   const MemberStringifiersMap& memberStringifiers,
+                                   const TypeStringifiersMap& typeStringifiers) :
+    m_device(device)
+  , m_mode(mode)
+  , m_serializer(memberStringifiers, typeStringifiers)
+  , m_writer(&m_buffer)
+  , m_chunkSize(64*1024)
+  , m_maxPendingBytes(1024*1024)
+  , m_writeTimeout(30000)
+  , m_bytesWritten(0)
+  , m_count(0)
+  , m_finished(false) {}
+
+///
+/// \brief StreamSerializer::flush writes the buffered output to the device. With a
+/// codec, part of the output may stay in the codec until finish().
+///
+bool StreamSerializer::flush()
+{
+    return drain(false);
+}
+
+///
+/// \brief StreamSerializer::finish closes the array and flushes. No object can be
+/// written afterwards.
+///
+bool StreamSerializer::finish()
+{
+    if (hasError())
+        return false;
+    if (m_finished)
+        return true;
+
+    if (m_mode == JsonArray) {
+        if (m_count == 0)
+            m_writer.beginArray();
+        m_writer.endArray();
+    }
+
+    m_finished = true;
+    return drain(true);
+}
+
+bool StreamSerializer::beginElement()
+{
+    if (hasError())
+        return false;
+    if (m_finished) {
+        m_errorString = QStringLiteral("Stream already finished");
+        return false;
+    }
+    if (!m_device || !m_device->isWritable()) {
+        m_errorString = QStringLiteral("Device not writable");
+        return false;
+    }
+
+    if (m_mode == JsonArray && m_count == 0)
+        m_writer.beginArray();
+    return true;
+}
+
+bool StreamSerializer::endElement()
+{
+    if (m_mode == JsonLines)
+        m_buffer.append('\n');
+
+    m_count++;
+    if (m_buffer.size() < m_chunkSize)
+        return true;
+    return flush();
+}
+
+bool StreamSerializer::drain(bool last)
+{
+    if (hasError())
+        return false;
+
+    QByteArray* pending = &m_buffer;
+    if (m_codec) {
+        if (!m_codec->process(m_buffer.constData(), m_buffer.size(), &m_encoded)
+                || (last && !m_codec->finish(&m_encoded))) {
+            m_errorString = m_codec->errorString();
+            return false;
+        }
+        m_buffer.clear();
+        pending = &m_encoded;
+    }
+
+    while (!pending->isEmpty()) {
+        if (!waitForDevice())
+            return false;
+
+        const qint64 written = m_device->write(pending->constData(), qMin(qint64(pending->size()), qint64(m_chunkSize)));
+        if (written < 0) {
+            m_errorString = m_device->errorString();
+            return false;
+        }
+
+        m_bytesWritten += written;
+        pending->remove(0, int(written));
+    }
+
+    return true;
+}
+
+bool StreamSerializer::waitForDevice()
+{
+    while (m_device->bytesToWrite() > m_maxPendingBytes) {
+        if (!m_device->waitForBytesWritten(m_writeTimeout)) {
+            m_errorString = QStringLiteral("Timeout waiting for the device");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+struct DeflateCodec::Private
+{
+    DeflateCodec::Direction direction;
+    DeflateCodec::Format format;
+    int level;
+    bool initialized;
+    bool finished;
+    QString errorString;
+#ifdef LQO_ZLIB
+    z_stream stream;
+#endif
+};
+
+DeflateCodec::DeflateCodec(Direction direction, Format format, int level) :
+    d(new Private)
+{
+    d->direction = direction;
+    d->format = format;
+    d->level = level;
+    d->initialized = false;
+    d->finished = false;
+}
+
+DeflateCodec::~DeflateCodec()
+{
+    reset();
+}
+
+bool DeflateCodec::isAvailable()
+{
+#ifdef LQO_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool DeflateCodec::process(const char* data, qsizetype size, QByteArray* out)
+{
+    if (!d->errorString.isEmpty())
+        return false;
+    if (size == 0)
+        return true;
+    if (d->finished) {
+        d->errorString = QStringLiteral("Data after the end of the stream");
+        return false;
+    }
+
+    return run(data, size, out, false);
+}
+
+bool DeflateCodec::finish(QByteArray* out)
+{
+    if (!d->errorString.isEmpty())
+        return false;
+    if (d->finished)
+        return true;
+    if (d->direction == Decompress) {
+        d->errorString = QStringLiteral("Truncated compressed stream");
+        return false;
+    }
+
+    return run(nullptr, 0, out, true);
+}
+
+void DeflateCodec::reset()
+{
+#ifdef LQO_ZLIB
+    if (d->initialized) {
+        if (d->direction == Compress)
+            deflateEnd(&d->stream);
+        else
+            inflateEnd(&d->stream);
+    }
+#endif
+    d->initialized = false;
+    d->finished = false;
+    d->errorString.clear();
+}
+
+QString DeflateCodec::errorString() const
+{
+    return d->errorString;
+}
+
+bool DeflateCodec::run(const char* data, qsizetype size, QByteArray* out, bool last)
+{
+#ifdef LQO_ZLIB
+    z_stream& stream = d->stream;
+    if (!d->initialized) {
+        memset(&stream, 0, sizeof(stream));
+        const int windowBits = d->format == Gzip ? MAX_WBITS + 16 : d->format == Raw ? -MAX_WBITS : MAX_WBITS;
+        const int ret = d->direction == Compress
+                ? deflateInit2(&stream, d->level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY)
+                : inflateInit2(&stream, windowBits);
+        if (ret != Z_OK) {
+            d->errorString = QStringLiteral("Failed to initialize zlib");
+            return false;
+        }
+        d->initialized = true;
+    }
+
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = uInt(size);
+
+    char chunk[16*1024];
+    while (true) {
+        stream.next_out = reinterpret_cast<Bytef*>(chunk);
+        stream.avail_out = sizeof(chunk);
+        const int ret = d->direction == Compress
+                ? deflate(&stream, last ? Z_FINISH : Z_NO_FLUSH)
+                : inflate(&stream, Z_NO_FLUSH);
+        out->append(chunk, int(sizeof(chunk) - stream.avail_out));
+
+        if (ret == Z_STREAM_END) {
+            d->finished = true;
+            return true;
+        }
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            d->errorString = stream.msg ? QString::fromLatin1(stream.msg) : QStringLiteral("zlib error %1").arg(ret);
+            return false;
+        }
+        if (!last && stream.avail_out != 0)
+            return true;
+    }
+#else
+    Q_UNUSED(data)
+    Q_UNUSED(size)
+    Q_UNUSED(out)
+    Q_UNUSED(last)
+    d->errorString = QStringLiteral("zlib is not available");
+    return false;
+#endif
+}
+
+static const quint64 PRIME64_1 = 11400714785074694791ULL;
+static const quint64 PRIME64_2 = 14029467366897019727ULL;
+static const quint64 PRIME64_3 = 1609587929392839161ULL;
+static const quint64 PRIME64_4 = 9650029242287828579ULL;
+static const quint64 PRIME64_5 = 2870177450012600261ULL;
+
+static inline quint64 rotl64(quint64 x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline quint64 xxh64_round(quint64 acc, quint64 input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+Hasher::Hasher(quint64 seed) :
+    m_state(seed + PRIME64_5)
+  , m_length(0)
+  , m_tail(0)
+  , m_tailSize(0) {}
+
+void Hasher::add(const void* data, qsizetype size)
+{
+    const uchar* p = static_cast<const uchar*>(data);
+    const uchar* end = p + size;
+    m_length += quint64(size);
+
+    while (m_tailSize != 0 && p < end) {
+        m_tail |= quint64(*p++) << (8*m_tailSize);
+        if (++m_tailSize == 8) {
+            mix(m_tail);
+            m_tail = 0;
+            m_tailSize = 0;
+        }
+    }
+
+    for (; end - p >= 8; p += 8) {
+        quint64 word;
+        memcpy(&word, p, sizeof(word));
+        mix(word);
+    }
+
+    while (p < end)
+        m_tail |= quint64(*p++) << (8*m_tailSize++);
+}
+
+quint64 Hasher::result() const
+{
+    quint64 h = m_state + m_length;
+    if (m_tailSize > 0)
+        h = rotl64(h ^ xxh64_round(0, m_tail), 27)*PRIME64_1 + PRIME64_4;
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+void Hasher::mix(quint64 word)
+{
+    m_state ^= xxh64_round(0, word);
+    m_state = rotl64(m_state, 27)*PRIME64_1 + PRIME64_4;
+}
+
+static void hash_type(Hasher& hasher, QJsonValue::Type type)
+{
+    const quint8 tag = quint8(type);
+    hasher.add(&tag, sizeof(tag));
+}
+
+static void hash_double(Hasher& hasher, double d)
+{
+    hash_type(hasher, QJsonValue::Double);
+    hasher.add(&d, sizeof(d));
+}
+
+static void hash_bool(Hasher& hasher, bool b)
+{
+    hash_type(hasher, QJsonValue::Bool);
+    const quint8 byte = b;
+    hasher.add(&byte, sizeof(byte));
+}
+
+static void hash_string(Hasher& hasher, const QString& s)
+{
+    hash_type(hasher, QJsonValue::String);
+    hasher.add(quint64(s.size()));
+    hasher.add(s.constData(), s.size()*qsizetype(sizeof(QChar)));
+}
+
+static void hash_json_value(Hasher& hasher, const QJsonValue& value)
+{
+    switch (value.type()) {
+    case QJsonValue::Null:
+    case QJsonValue::Undefined:
+        hash_type(hasher, value.type());
+        break;
+    case QJsonValue::Bool:
+        hash_bool(hasher, value.toBool());
+        break;
+    case QJsonValue::Double:
+        hash_double(hasher, value.toDouble());
+        break;
+    case QJsonValue::String:
+        hash_string(hasher, value.toString());
+        break;
+    case QJsonValue::Array: {
+        const QJsonArray array = value.toArray();
+        hash_type(hasher, QJsonValue::Array);
+        hasher.add(quint64(array.size()));
+        for (const QJsonValue& element : array)
+            hash_json_value(hasher, element);
+        break;
+    }
+    case QJsonValue::Object: {
+        // Keys of a QJsonObject are sorted, so dictionaries hash the same regardless
+        // of the iteration order of the container they come from.
+        const QJsonObject object = value.toObject();
+        hash_type(hasher, QJsonValue::Object);
+        hasher.add(quint64(object.size()));
+        for (QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it) {
+            hash_string(hasher, it.key());
+            hash_json_value(hasher, it.value());
+        }
+        break;
+    }
+    }
+}
+
+quint64 hash_json(const QJsonValue& value)
+{
+    Hasher hasher;
+    hash_json_value(hasher, value);
+    return hasher.result();
+}
+
+Q_GLOBAL_STATIC(QReadWriteLock, s_sharedGadgetKernelsLock)
+typedef QHash<int, SharedGadgetKernel> SharedGadgetKernels;
+Q_GLOBAL_STATIC(SharedGadgetKernels, s_sharedGadgetKernels)
+static QBasicAtomicInt s_sharedGadgetTypes = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+void register_shared_gadget_kernel(int metaTypeId, const SharedGadgetKernel& kernel)
+{
+    QWriteLocker locker(s_sharedGadgetKernelsLock());
+    s_sharedGadgetKernels->insert(metaTypeId, kernel);
+    s_sharedGadgetTypes.ref();
+    s_registryGeneration.ref();
+}
+
+bool shared_gadget_kernel(int metaTypeId, SharedGadgetKernel* kernel)
+{
+    if (!s_sharedGadgetTypes.loadAcquire())
+        return false;
+
+    QReadLocker locker(s_sharedGadgetKernelsLock());
+    SharedGadgetKernels::const_iterator it = s_sharedGadgetKernels->constFind(metaTypeId);
+    if (it == s_sharedGadgetKernels->constEnd())
+        return false;
+
+    *kernel = it.value();
+    return true;
+}
+
+Columns::Columns(const QMetaObject* schema) :
+    m_schema(schema)
+  , m_rowCount(0)
+{
+    if (!schema)
+        return;
+
+    for (int i = 0; i < schema->propertyCount(); i++) {
+        const QMetaProperty metaProp = schema->property(i);
+        if (metaProp.enclosingMetaObject() == &QObject::staticMetaObject)
+            continue;
+
+        Column column;
+        column.name = QString::fromLatin1(metaProp.name());
+        switch (metaProp.userType()) {
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::Long:
+        case QMetaType::LongLong:
+        case QMetaType::Short:
+        case QMetaType::ULong:
+        case QMetaType::ULongLong:
+        case QMetaType::UShort:
+            column.type = IntColumn;
+            break;
+        case QMetaType::Float:
+        case QMetaType::Double:
+            column.type = DoubleColumn;
+            break;
+        case QMetaType::Bool:
+            column.type = BoolColumn;
+            break;
+        case QMetaType::QString:
+            column.type = StringColumn;
+            column.offsets.append(0);
+            break;
+        default:
+            continue;
+        }
+
+        m_columns.append(column);
+    }
+}
+
+int Columns::indexOf(const QString& name) const
+{
+    for (int i = 0; i < m_columns.size(); i++)
+        if (m_columns.at(i).name == name)
+            return i;
+    return -1;
+}
+
+QStringView Columns::string(int column, int row) const
+{
+    const Column& c = m_columns.at(column);
+    const int offset = c.offsets.at(row);
+    return QStringView(c.strings).mid(offset, c.offsets.at(row + 1) - offset);
+}
+
+void Columns::reserve(int rows)
+{
+    for (Column& column : m_columns) {
+        switch (column.type) {
+        case IntColumn:
+            column.ints.reserve(rows);
+            break;
+        case DoubleColumn:
+            column.doubles.reserve(rows);
+            break;
+        case BoolColumn:
+            column.bools.reserve(rows);
+            break;
+        case StringColumn:
+            column.offsets.reserve(rows + 1);
+            break;
+        }
+    }
+}
+
+void Columns::appendRow(const QJsonObject& object)
+{
+    for (Column& column : m_columns) {
+        const QJsonValue value = object.value(column.name);
+        switch (column.type) {
+        case IntColumn:
+            column.ints.append(json_to<qlonglong>(value));
+            break;
+        case DoubleColumn:
+            column.doubles.append(value.toDouble());
+            break;
+        case BoolColumn:
+            column.bools.append(value.toBool());
+            break;
+        case StringColumn:
+            column.strings.append(value.toString());
+            column.offsets.append(column.strings.size());
+            break;
+        }
+    }
+
+    m_rowCount++;
+}
+
+void Columns::appendNull()
+{
+    appendRow(QJsonObject());
+    m_nullRows.append(m_rowCount - 1);
+}
+
+bool Columns::isNull(int row) const
+{
+    return std::binary_search(m_nullRows.constBegin(), m_nullRows.constEnd(), row);
+}
+
+void Columns::clear()
+{
+    for (Column& column : m_columns) {
+        column.ints.clear();
+        column.doubles.clear();
+        column.bools.clear();
+        column.strings.clear();
+        column.offsets.clear();
+        if (column.type == StringColumn)
+            column.offsets.append(0);
+    }
+
+    m_nullRows.clear();
+    m_rowCount = 0;
+}
+
+bool Columns::operator==(const Columns& other) const
+{
+    if (m_schema != other.m_schema || m_rowCount != other.m_rowCount || m_nullRows != other.m_nullRows)
+        return false;
+
+    for (int i = 0; i < m_columns.size(); i++) {
+        const Column& a = m_columns.at(i);
+        const Column& b = other.m_columns.at(i);
+        if (a.ints != b.ints || a.doubles != b.doubles || a.bools != b.bools
+                || a.strings != b.strings || a.offsets != b.offsets)
+            return false;
+    }
+
+    return true;
+}
+
+QVariant Columns::Row::value(int column) const
+{
+    if (column < 0 || column >= m_columns->columnCount() || isNull())
+        return QVariant();
+
+    switch (m_columns->column(column).type) {
+    case IntColumn:
+        return toInt(column);
+    case DoubleColumn:
+        return toDouble(column);
+    case BoolColumn:
+        return toBool(column);
+    case StringColumn:
+        return toString(column).toString();
+    }
+
+    return QVariant();
+}
+
+Q_GLOBAL_STATIC(QReadWriteLock, s_columnarKernelsLock)
+typedef QHash<int, ColumnarKernel> ColumnarKernels;
+Q_GLOBAL_STATIC(ColumnarKernels, s_columnarKernels)
+static QBasicAtomicInt s_columnarTypes = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+void register_columnar_kernel(int metaTypeId, const ColumnarKernel& kernel)
+{
+    QWriteLocker locker(s_columnarKernelsLock());
+    s_columnarKernels->insert(metaTypeId, kernel);
+    s_columnarTypes.ref();
+    s_registryGeneration.ref();
+}
+
+bool columnar_kernel(int metaTypeId, ColumnarKernel* kernel)
+{
+    if (!s_columnarTypes.loadAcquire())
+        return false;
+
+    QReadLocker locker(s_columnarKernelsLock());
+    ColumnarKernels::const_iterator it = s_columnarKernels->constFind(metaTypeId);
+    if (it == s_columnarKernels->constEnd())
+        return false;
+
+    *kernel = it.value();
+    return true;
+}
+
+SerializationCache::SerializationCache(const MemberStringifiersMap& memberStringifiers,
+                                       const TypeStringifiersMap& typeStringifiers,
+                                       QObject* parent) :
+    QObject(parent)
+  , m_serializer(memberStringifiers, typeStringifiers)
+  , m_renderCount(0)
+  , m_uncachedChild(false) {}
+
+QJsonObject SerializationCache::serialize(QObject* object)
+{
+    if (!object)
+        return QJsonObject();
+
+    m_uncachedChild = false;
+    return render(object);
+}
+
+///
+/// \brief SerializationCache::invalidate forces object to be serialized again, e.g.
+/// when a property without notify signal changed.
+///
+void SerializationCache::invalidate(QObject* object)
+{
+    markDirty(object);
+}
+
+void SerializationCache::clear()
+{
+    for (QHash<QObject*, Entry>::const_iterator it = m_entries.constBegin(); it != m_entries.constEnd(); ++it)
+        disconnect(it.key(), nullptr, this, nullptr);
+    m_entries.clear();
+}
+
+void SerializationCache::onPropertyChanged()
+{
+    markDirty(sender());
+}
+
+void SerializationCache::onDestroyed(QObject* object)
+{
+    unlinkChildren(object);
+    const Entry entry = m_entries.take(object);
+    for (QObject* parent : entry.parents) {
+        QHash<QObject*, Entry>::iterator it = m_entries.find(parent);
+        if (it != m_entries.end())
+            it->children.remove(object);
+        markDirty(parent);
+    }
+}
+
+void SerializationCache::track(QObject* object)
+{
+    static const QMetaMethod slot = staticMetaObject.method(staticMetaObject.indexOfSlot("onPropertyChanged()"));
+
+    Entry entry;
+    entry.dirty = true;
+    entry.cacheable = true;
+
+    const QMetaObject* metaObj = object->metaObject();
+    QSet<int> connectedSignals;
+    for (int i = 0; i < metaObj->propertyCount(); ++i) {
+        const QMetaProperty metaProp = metaObj->property(i);
+        if (metaProp.isConstant())
+            continue;
+        if (!metaProp.hasNotifySignal()) {
+            entry.cacheable = false;
+            continue;
+        }
+        if (connectedSignals.contains(metaProp.notifySignalIndex()))
+            continue;
+
+        connectedSignals.insert(metaProp.notifySignalIndex());
+        connect(object, metaProp.notifySignal(), this, slot);
+    }
+
+    connect(object, &QObject::destroyed, this, &SerializationCache::onDestroyed);
+    m_entries.insert(object, entry);
+}
+
+QJsonObject SerializationCache::render(QObject* object)
+{
+    QHash<QObject*, Entry>::const_iterator it = m_entries.constFind(object);
+    if (it == m_entries.constEnd())
+        track(object);
+    else if (!it->dirty)
+        return it->json;
+
+    // Children are collected again, so the links of replaced children are dropped.
+    unlinkChildren(object);
+
+    // An object containing an object that cannot be cached cannot be cached either.
+    const bool outerUncached = m_uncachedChild;
+    m_uncachedChild = false;
+
+    const QMetaObject* metaObj = object->metaObject();
+    QJsonObject json;
+    for (int i = 0; i < metaObj->propertyCount(); ++i) {
+        const QMetaProperty metaProp = metaObj->property(i);
+        const QVariant value = metaProp.read(object);
+
+        // This is the case of objectName. Only add it to the json if it is not empty.
+        if (metaProp.enclosingMetaObject() == &QObject::staticMetaObject && value.toString().isEmpty())
+            continue;
+
+        json[metaProp.name()] = renderValue(object, metaProp, value);
+    }
+
+    QString typeKey;
+    QString typeName;
+    if (polymorphic_discriminator(metaObj, &typeKey, &typeName))
+        json[typeKey] = typeName;
+
+    // Children may have been added to the hash: look the entry up again.
+    Entry& entry = m_entries[object];
+    entry.json = json;
+    entry.dirty = !entry.cacheable || m_uncachedChild;
+    m_uncachedChild = outerUncached || entry.dirty;
+    m_renderCount++;
+    return json;
+}
+
+QJsonValue SerializationCache::renderChild(QObject* parent, QObject* child)
+{
+    if (!child)
+        return QJsonValue::Null;
+
+    const QJsonObject json = render(child);
+    m_entries[child].parents.insert(parent);
+    m_entries[parent].children.insert(child);
+    return json;
+}
+
+void SerializationCache::unlinkChildren(QObject* object)
+{
+    QHash<QObject*, Entry>::iterator it = m_entries.find(object);
+    if (it == m_entries.end())
+        return;
+
+    const QSet<QObject*> children = it->children;
+    it->children.clear();
+    for (QObject* child : children) {
+        QHash<QObject*, Entry>::iterator childIt = m_entries.find(child);
+        if (childIt != m_entries.end())
+            childIt->parents.remove(object);
+    }
+}
+
+QJsonValue SerializationCache::renderValue(QObject* object, const QMetaProperty& metaProp, const QVariant& value)
+{
+    const QMetaType metaType(value.userType());
+    if (metaType.flags().testFlag(QMetaType::PointerToQObject))
+        return renderChild(object, value.value<QObject*>());
+
+    if (value.canConvert<QVariantList>()) {
+        const LSequentialIterable it = value.value<LSequentialIterable>();
+        if (it.size() > 0 && QMetaType(it.at(0).userType()).flags().testFlag(QMetaType::PointerToQObject)) {
+            QJsonArray array;
+            for (const QVariant& element : it) {
+                if (QMetaType(element.userType()).flags().testFlag(QMetaType::PointerToQObject))
+                    array.append(renderChild(object, element.value<QObject*>()));
+                else
+                    array.append(m_serializer.serializeValue(nullptr, element, metaProp.enclosingMetaObject()));
+            }
+            return array;
+        }
+    }
+
+    return m_serializer.serializeValue(metaProp.name(), value, metaProp.enclosingMetaObject());
+}
+
+void SerializationCache::markDirty(QObject* object)
+{
+    QHash<QObject*, Entry>::iterator it = m_entries.find(object);
+    if (it == m_entries.end() || it->dirty)
+        return;
+
+    // A dirty object always has dirty ancestors, so the walk stops at the first
+    // object that is already dirty.
+    it->dirty = true;
+    const QSet<QObject*> parents = it->parents;
+    for (QObject* parent : parents)
+        markDirty(parent);
+}
+
+ObjectListModel::ObjectListModel(const QMetaObject* metaObject, QObject* parent) :
+    QAbstractListModel(parent)
+  , m_metaObject(metaObject) {}
+
+ObjectListModel::~ObjectListModel()
+{
+    qDeleteAll(m_objects);
+}
+
+int ObjectListModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : m_objects.size();
+}
+
+QVariant ObjectListModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_objects.size())
+        return QVariant();
+
+    QObject* obj = m_objects.at(index.row());
+    if (role == ObjectRole)
+        return QVariant::fromValue(obj);
+
+    const int propIndex = role - FirstPropertyRole;
+    if (!obj || propIndex < 0 || propIndex >= m_metaObject->propertyCount())
+        return QVariant();
+    return m_metaObject->property(propIndex).read(obj);
+}
+
+QHash<int, QByteArray> ObjectListModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles.insert(ObjectRole, QByteArrayLiteral("object"));
+    for (int i = 0; i < m_metaObject->propertyCount(); i++)
+        roles.insert(FirstPropertyRole + i, QByteArray(m_metaObject->property(i).name()));
+    return roles;
+}
+
+void ObjectListModel::append(const QList<QObject*>& objects)
+{
+    if (objects.isEmpty())
+        return;
+
+    beginInsertRows(QModelIndex(), m_objects.size(), m_objects.size() + objects.size() - 1);
+    m_objects.append(objects);
+    endInsertRows();
+    emit countChanged();
+}
+
+void ObjectListModel::clear()
+{
+    beginResetModel();
+    qDeleteAll(m_objects);
+    m_objects.clear();
+    endResetModel();
+    emit countChanged();
+}
+
+struct DictionaryKernels : public QHash<int, DictionaryKernel>
+{
+    DictionaryKernels();
+
+    template<class V> void insertValue() {
+        insert(qMetaTypeId<QHash<QString, V> >(), make_value_dictionary_kernel<QHash<QString, V>, V>());
+        insert(qMetaTypeId<QMap<QString, V> >(), make_value_dictionary_kernel<QMap<QString, V>, V>());
+    }
+};
+
+DictionaryKernels::DictionaryKernels()
+{
+    insertValue<int>();
+    insertValue<qlonglong>();
+    insertValue<float>();
+    insertValue<double>();
+    insertValue<bool>();
+    insertValue<QString>();
+    insert(qMetaTypeId<QHash<QString, QObject*> >(),
+           make_dictionary_kernel<QHash<QString, QObject*>, QObject*>(DictionaryKernel::ObjectPointer));
+    insert(qMetaTypeId<QMap<QString, QObject*> >(),
+           make_dictionary_kernel<QMap<QString, QObject*>, QObject*>(DictionaryKernel::ObjectPointer));
+}
+
+Q_GLOBAL_STATIC(QReadWriteLock, s_dictionaryKernelsLock)
+Q_GLOBAL_STATIC(DictionaryKernels, s_dictionaryKernels)
+
+void register_dictionary_kernel(int metaTypeId, const DictionaryKernel& kernel)
+{
+    QWriteLocker locker(s_dictionaryKernelsLock());
+    s_dictionaryKernels->insert(metaTypeId, kernel);
+    s_registryGeneration.ref();
+}
+
+bool dictionary_kernel(int metaTypeId, DictionaryKernel* kernel)
+{
+    QReadLocker locker(s_dictionaryKernelsLock());
+    DictionaryKernels::const_iterator it = s_dictionaryKernels->constFind(metaTypeId);
+    if (it == s_dictionaryKernels->constEnd())
+        return false;
+
+    *kernel = it.value();
+    return true;
+}
+
+PropertyKernel property_kernel(int metaTypeId)
+{
+    PropertyKernel ret = PropertyKernel();
+    if (shared_gadget_kernel(metaTypeId, &ret.sharedGadget))
+        ret.kind = PropertyKernel::SharedGadget;
+    else if (dictionary_kernel(metaTypeId, &ret.dictionary))
+        ret.kind = PropertyKernel::Dictionary;
+    else if (columnar_kernel(metaTypeId, &ret.columnar))
+        ret.kind = PropertyKernel::Columnar;
+    else if (gadget_array_kernel(metaTypeId, &ret.gadgetArray))
+        ret.kind = PropertyKernel::GadgetArray;
+    return ret;
+}
+
+ObjectPlan make_object_plan(const QMetaObject* metaObject)
+{
+    ObjectPlan plan;
+    plan.properties.reserve(metaObject->propertyCount());
+    plan.kernels.reserve(metaObject->propertyCount());
+    for (int i = 0; i < metaObject->propertyCount(); i++) {
+        const QMetaProperty metaProp = metaObject->property(i);
+        const QString name = QString::fromLatin1(metaProp.name());
+        if (!plan.properties.contains(name))
+            plan.properties.insert(name, i);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        plan.kernels.append(property_kernel(metaProp.metaType().id()));
+#else
+        plan.kernels.append(property_kernel(QMetaType::type(metaProp.typeName())));
+#endif
+    }
+
+    const int classInfoIndex = metaObject->indexOfClassInfo("lqo.required");
+    if (classInfoIndex >= 0) {
+        const QStringList required = QString::fromLatin1(metaObject->classInfo(classInfoIndex).value()).split(QLatin1Char(','));
+        for (const QString& name : required)
+            if (!name.trimmed().isEmpty())
+                plan.required.append(name.trimmed());
+    }
+
+    polymorphic_subtypes(metaObject, &plan.discriminator, &plan.subtypes);
+    QString typeName;
+    polymorphic_discriminator(metaObject, &plan.typeKey, &typeName);
+
+    return plan;
+}
+
+void LimitScanner::reset(const Limits& limits)
+{
+    m_limits = limits;
+    m_enabled = limits.maxDepth >= 0 || limits.maxArrayLength >= 0 || limits.maxObjects >= 0 || limits.maxStringBytes >= 0;
+    m_elements.clear();
+    m_arrayStart = false;
+    m_objects = 0;
+    m_stringBytes = 0;
+    m_inString = false;
+    m_escape = false;
+    m_hexDigits = 0;
+    m_codePoint = 0;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return 0;
+}
+
+static int utf8_code_point_size(uint codePoint)
+{
+    // Each half of a surrogate pair accounts for half of the 4 byte sequence.
+    if (codePoint < 0x80)
+        return 1;
+    if (codePoint < 0x800 || (codePoint >= 0xd800 && codePoint < 0xe000))
+        return 2;
+    return 3;
+}
+
+///
+/// \brief LimitScanner::feed scans the next chunk of the text and returns the name of
+/// the first limit that is exceeded, or nullptr.
+///
+const char* LimitScanner::feed(const char* data, qsizetype size)
+{
+    if (!m_enabled)
+        return nullptr;
+
+    for (qsizetype i = 0; i < size; i++) {
+        const char c = data[i];
+        if (m_inString) {
+            int bytes = 0;
+            if (m_hexDigits > 0) {
+                m_codePoint = (m_codePoint << 4) | uint(hex_value(c));
+                if (--m_hexDigits == 0)
+                    bytes = utf8_code_point_size(m_codePoint);
+            }
+            else if (m_escape) {
+                m_escape = false;
+                if (c == 'u') {
+                    m_hexDigits = 4;
+                    m_codePoint = 0;
+                }
+                else
+                    bytes = 1;
+            }
+            else if (c == '\\')
+                m_escape = true;
+            else if (c == '"')
+                m_inString = false;
+            else
+                bytes = 1;
+
+            m_stringBytes += bytes;
+            if (m_limits.maxStringBytes >= 0 && m_stringBytes > m_limits.maxStringBytes)
+                return "maxStringBytes";
+            continue;
+        }
+
+        // The first element of an array is counted at its first character.
+        if (m_arrayStart && c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+            m_arrayStart = false;
+            if (c != ']' && m_limits.maxArrayLength >= 0 && ++m_elements.last() > m_limits.maxArrayLength)
+                return "maxArrayLength";
+        }
+
+        switch (c) {
+        case '"':
+            m_inString = true;
+            break;
+        case '{':
+            if (m_limits.maxObjects >= 0 && ++m_objects > m_limits.maxObjects)
+                return "maxObjects";
+            Q_FALLTHROUGH();
+        case '[':
+            if (m_limits.maxDepth >= 0 && m_elements.size() >= m_limits.maxDepth)
+                return "maxDepth";
+            m_elements.append(c == '[' ? 0 : -1);
+            m_arrayStart = c == '[';
+            break;
+        case ']':
+        case '}':
+            if (!m_elements.isEmpty())
+                m_elements.removeLast();
+            break;
+        case ',':
+            if (m_limits.maxArrayLength >= 0 && !m_elements.isEmpty() && m_elements.last() >= 0
+                    && ++m_elements.last() > m_limits.maxArrayLength)
+                return "maxArrayLength";
+            break;
+        }
+    }
+
+    return nullptr;
+}
+
+///
+/// \brief check_json_limits scans a complete JSON text without parsing it and returns
+/// the name of the first limit that is exceeded, or nullptr.
+///
+const char* check_json_limits(const char* data, qsizetype size, const Limits& limits)
+{
+    LimitScanner scanner(limits);
+    return scanner.feed(data, size);
+}
+
+static qint64 utf8_size(const QString& s)
+{
+    qint64 ret = 0;
+    for (const QChar c : s)
+        ret += utf8_code_point_size(c.unicode());
+    return ret;
+}
+
+static const char* check_value_limits(const QJsonValue& value, const Limits& limits, int depth, qint64* objects, qint64* stringBytes)
+{
+    switch (value.type()) {
+    case QJsonValue::String:
+        if (limits.maxStringBytes >= 0 && (*stringBytes += utf8_size(value.toString())) > limits.maxStringBytes)
+            return "maxStringBytes";
+        return nullptr;
+    case QJsonValue::Array: {
+        if (limits.maxDepth >= 0 && depth >= limits.maxDepth)
+            return "maxDepth";
+        const QJsonArray array = value.toArray();
+        if (limits.maxArrayLength >= 0 && array.size() > limits.maxArrayLength)
+            return "maxArrayLength";
+        for (const QJsonValue& element : array)
+            if (const char* limit = check_value_limits(element, limits, depth + 1, objects, stringBytes))
+                return limit;
+        return nullptr;
+    }
+    case QJsonValue::Object: {
+        if (limits.maxObjects >= 0 && ++*objects > limits.maxObjects)
+            return "maxObjects";
+        if (limits.maxDepth >= 0 && depth >= limits.maxDepth)
+            return "maxDepth";
+        const QJsonObject object = value.toObject();
+        for (QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it) {
+            if (limits.maxStringBytes >= 0 && (*stringBytes += utf8_size(it.key())) > limits.maxStringBytes)
+                return "maxStringBytes";
+            if (const char* limit = check_value_limits(it.value(), limits, depth + 1, objects, stringBytes))
+                return limit;
+        }
+        return nullptr;
+    }
+    default:
+        return nullptr;
+    }
+}
+
+///
+/// \brief check_json_limits checks a parsed value with the same definitions used to
+/// scan JSON text.
+///
+const char* check_json_limits(const QJsonValue& value, const Limits& limits)
+{
+    if (limits.maxDepth < 0 && limits.maxArrayLength < 0 && limits.maxObjects < 0 && limits.maxStringBytes < 0)
+        return nullptr;
+
+    qint64 objects = 0;
+    qint64 stringBytes = 0;
+    return check_value_limits(value, limits, 0, &objects, &stringBytes);
+}
+
+// Estimated size of the private data of a QObject without children or connections.
+static const qint64 QOBJECT_PRIVATE_SIZE = 128;
+
+MemoryUsage& MemoryUsage::operator+=(const MemoryUsage& other)
+{
+    instances += other.instances;
+    objectBytes += other.objectBytes;
+    stringBytes += other.stringBytes;
+    containerBytes += other.containerBytes;
+    otherBytes += other.otherBytes;
+    return *this;
+}
+
+bool MemoryUsage::operator==(const MemoryUsage& other) const
+{
+    return instances == other.instances
+            && objectBytes == other.objectBytes
+            && stringBytes == other.stringBytes
+            && containerBytes == other.containerBytes
+            && otherBytes == other.otherBytes;
+}
+
+MemoryUsage MemoryReport::total() const
+{
+    MemoryUsage ret;
+    for (const MemoryUsage& usage : types)
+        ret += usage;
+    return ret;
+}
+
+MemoryReport& MemoryReport::operator+=(const MemoryReport& other)
+{
+    for (QHash<const QMetaObject*, MemoryUsage>::const_iterator it = other.types.constBegin(); it != other.types.constEnd(); ++it)
+        types[it.key()] += it.value();
+    return *this;
+}
+
+static qint64 heap_size(const QString& s)
+{
+    return s.capacity() > 0 ? qint64(sizeof(QArrayData)) + (s.capacity() + 1)*qint64(sizeof(QChar)) : 0;
+}
+
+static qint64 heap_size(const QByteArray& b)
+{
+    return b.capacity() > 0 ? qint64(sizeof(QArrayData)) + b.capacity() + 1 : 0;
+}
+
+template<class V>
+static qint64 heap_size(const QVector<V>& v)
+{
+    return v.capacity() > 0 ? qint64(sizeof(QArrayData)) + v.capacity()*qint64(sizeof(V)) : 0;
+}
+
+///
+/// \brief Columns::memoryUsage estimates the heap held by the columns. Rows are not
+/// objects, so no instances are accounted.
+///
+MemoryUsage Columns::memoryUsage() const
+{
+    MemoryUsage ret;
+    ret.containerBytes = heap_size(m_columns) + heap_size(m_nullRows);
+    for (const Column& column : m_columns) {
+        ret.stringBytes += heap_size(column.name) + heap_size(column.strings);
+        ret.containerBytes += heap_size(column.ints) + heap_size(column.doubles)
+                + heap_size(column.bools) + heap_size(column.offsets);
+    }
+    return ret;
+}
+
+///
+/// \brief json_heap_size estimates the heap held by a parsed JSON value from its
+/// structure, without serializing it.
+///
+static qint64 json_heap_size(const QJsonValue& value)
+{
+    switch (value.type()) {
+    case QJsonValue::String:
+        return heap_size(value.toString());
+    case QJsonValue::Array: {
+        const QJsonArray array = value.toArray();
+        qint64 ret = sizeof(QArrayData) + array.size()*qint64(sizeof(QJsonValue));
+        for (const QJsonValue& element : array)
+            ret += json_heap_size(element);
+        return ret;
+    }
+    case QJsonValue::Object: {
+        const QJsonObject object = value.toObject();
+        qint64 ret = sizeof(QArrayData) + 2*object.size()*qint64(sizeof(QJsonValue));
+        for (QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it)
+            ret += heap_size(it.key()) + json_heap_size(it.value());
+        return ret;
+    }
+    default:
+        return 0;
+    }
+}
+
+///
+/// \brief RawJson::heapSize estimates the heap held by the value, without converting it.
+///
+qint64 RawJson::heapSize() const
+{
+    return m_hasValue ? json_heap_size(m_value) : heap_size(m_json);
+}
+
+static qint64 type_size(int typeId)
+{
+    const int size = QMetaType(typeId).sizeOf();
+    return size > 0 ? size : 0;
+}
+
+static qint64 instance_size(const QMetaObject* metaObject)
+{
+    const bool isGadget = !metaObject->inherits(&QObject::staticMetaObject);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    if (isGadget && metaObject->metaType().isValid())
+        return metaObject->metaType().sizeOf();
+#else
+    if (isGadget) {
+        const int typeId = QMetaType::type(metaObject->className());
+        if (typeId != QMetaType::UnknownType)
+            return type_size(typeId);
+    }
+#endif
+
+    // Properties are assumed to be stored in members of their type.
+    qint64 size = isGadget ? 0 : qint64(sizeof(QObject)) + QOBJECT_PRIVATE_SIZE;
+    const int first = isGadget ? 0 : QObject::staticMetaObject.propertyCount();
+    for (int i = first; i < metaObject->propertyCount(); i++)
+        size += type_size(metaObject->property(i).userType());
+    return size;
+}
+
+static void add_object(MemoryReport* report, const QMetaObject* metaObject)
+{
+    MemoryUsage& usage = report->types[metaObject];
+    usage.instances++;
+    usage.objectBytes += instance_size(metaObject);
+}
+
+///
+/// \brief add_value accounts the heap held by value, excluding the objects it points to.
+///
+static void add_value(MemoryReport* report, const QMetaObject* metaObject, const QVariant& value)
+{
+    QHash<const QMetaObject*, MemoryUsage>& types = report->types;
+    const int typeId = value.userType();
+    switch (typeId) {
+    case QMetaType::UnknownType:
+        return;
+    case QMetaType::QString:
+        types[metaObject].stringBytes += heap_size(*reinterpret_cast<const QString*>(value.constData()));
+        return;
+    case QMetaType::QByteArray:
+        types[metaObject].otherBytes += heap_size(*reinterpret_cast<const QByteArray*>(value.constData()));
+        return;
+    default:
+        break;
+    }
+
+    if (typeId == qMetaTypeId<RawJson>()) {
+        types[metaObject].otherBytes += reinterpret_cast<const RawJson*>(value.constData())->heapSize();
+        return;
+    }
+
+    const QMetaType metaType(typeId);
+    if (metaType.flags().testFlag(QMetaType::PointerToQObject) || metaType.flags().testFlag(QMetaType::PointerToGadget))
+        return;
+
+    if (value.canConvert<QVariantList>()) {
+        const LSequentialIterable it = value.value<LSequentialIterable>();
+        const qint64 count = it.size();
+        qint64 bytes = sizeof(QArrayData);
+        qint64 strings = 0;
+        for (const QVariant& element : it) {
+            const qint64 elementSize = type_size(element.userType());
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+            bytes += elementSize;
+#else
+            // QList stores pointers, and allocates larger elements separately.
+            bytes += sizeof(void*) + (elementSize > qint64(sizeof(void*)) ? elementSize : 0);
+#endif
+            if (element.userType() == QMetaType::QString)
+                strings += heap_size(element.toString());
+        }
+        MemoryUsage& usage = types[metaObject];
+        usage.containerBytes += count > 0 ? bytes : 0;
+        usage.stringBytes += strings;
+        return;
+    }
+
+    if (value.canConvert<QVariantHash>() || value.canConvert<QVariantMap>()) {
+        const QVariantHash hash = value.canConvert<QVariantHash>() ? value.toHash() : QVariantHash();
+        const QVariantMap map = hash.isEmpty() ? value.toMap() : QVariantMap();
+        qint64 bytes = 0;
+        qint64 strings = 0;
+        // Each node holds the key, the value and a couple of pointers.
+        const qint64 nodeSize = 2*sizeof(void*) + sizeof(QString) + sizeof(QVariant);
+        for (QVariantHash::const_iterator it = hash.constBegin(); it != hash.constEnd(); ++it) {
+            bytes += nodeSize;
+            strings += heap_size(it.key());
+            if (it.value().userType() == QMetaType::QString)
+                strings += heap_size(it.value().toString());
+        }
+        for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+            bytes += nodeSize;
+            strings += heap_size(it.key());
+            if (it.value().userType() == QMetaType::QString)
+                strings += heap_size(it.value().toString());
+        }
+        MemoryUsage& usage = types[metaObject];
+        usage.containerBytes += bytes;
+        usage.stringBytes += strings;
+    }
+}
+
+static void measure_object(MemoryReport* report, QSet<const void*>* visited, const void* object, const QMetaObject* metaObject, bool inlineStorage);
+
+static void measure_value(MemoryReport* report, QSet<const void*>* visited, const QMetaObject* metaObject, const QVariant& value)
+{
+    const QMetaType metaType(value.userType());
+    if (metaType.flags().testFlag(QMetaType::PointerToQObject)) {
+        const QObject* child = value.value<QObject*>();
+        if (child)
+            measure_object(report, visited, child, child->metaObject(), false);
+        return;
+    }
+
+    if (metaType.flags().testFlag(QMetaType::PointerToGadget)) {
+        const void* gadget = *reinterpret_cast<void* const*>(value.constData());
+        if (gadget)
+            measure_object(report, visited, gadget, metaType.metaObject(), false);
+        return;
+    }
+
+    SharedGadgetKernel sharedKernel;
+    if (shared_gadget_kernel(metaType.id(), &sharedKernel)) {
+        const void* gadget = sharedKernel.get(value);
+        if (gadget)
+            measure_object(report, visited, gadget, QMetaType(sharedKernel.gadgetPointerType).metaObject(), false);
+        return;
+    }
+
+    GadgetArrayKernel gadgetKernel;
+    if (gadget_array_kernel(metaType.id(), &gadgetKernel)) {
+        const QMetaObject* elementMetaObject = gadgetKernel.metaObject;
+        qint64 count = 0;
+        gadgetKernel.visit(value, [report, visited, elementMetaObject, &count] (const void* element) {
+            measure_object(report, visited, element, elementMetaObject, true);
+            count++;
+        });
+        report->types[metaObject].containerBytes += count*instance_size(elementMetaObject);
+        return;
+    }
+
+    DictionaryKernel dictionaryKernel;
+    if (dictionary_kernel(metaType.id(), &dictionaryKernel)) {
+        const DictionaryKernel::Kind kind = dictionaryKernel.kind;
+        const int valueType = dictionaryKernel.valueType;
+        const QMetaObject* valueMetaObject = QMetaType(valueType).metaObject();
+        // Each node holds the key, the value and a couple of pointers.
+        const qint64 nodeSize = 2*sizeof(void*) + sizeof(QString) + type_size(valueType);
+        qint64 bytes = 0;
+        qint64 strings = 0;
+        dictionaryKernel.visit(value, [&] (const QString& key, const void* element) {
+            bytes += nodeSize;
+            strings += heap_size(key);
+            if (kind == DictionaryKernel::ObjectPointer) {
+                const QObject* child = *reinterpret_cast<QObject* const*>(element);
+                if (child)
+                    measure_object(report, visited, child, child->metaObject(), false);
+            }
+            else if (kind == DictionaryKernel::Gadget)
+                measure_object(report, visited, element, valueMetaObject, true);
+            else if (valueType == QMetaType::QString)
+                strings += heap_size(*reinterpret_cast<const QString*>(element));
+        });
+        MemoryUsage& usage = report->types[metaObject];
+        usage.containerBytes += bytes;
+        usage.stringBytes += strings;
+        return;
+    }
+
+    ColumnarKernel columnarKernel;
+    if (columnar_kernel(metaType.id(), &columnarKernel)) {
+        report->types[metaObject] += columnarKernel.columns(value)->memoryUsage();
+        return;
+    }
+
+    add_value(report, metaObject, value);
+    if (value.canConvert<QVariantList>()) {
+        const LSequentialIterable it = value.value<LSequentialIterable>();
+        for (const QVariant& element : it) {
+            const QMetaType elementType(element.userType());
+            if (elementType.flags().testFlag(QMetaType::PointerToQObject)
+                    || elementType.flags().testFlag(QMetaType::PointerToGadget))
+                measure_value(report, visited, metaObject, element);
+        }
+    }
+}
+
+static void measure_object(MemoryReport* report, QSet<const void*>* visited, const void* object, const QMetaObject* metaObject, bool inlineStorage)
+{
+    // Objects reachable from more than one property, like shared gadgets, count once.
+    if (!inlineStorage) {
+        if (visited->contains(object))
+            return;
+        visited->insert(object);
+    }
+
+    const bool isGadget = !metaObject->inherits(&QObject::staticMetaObject);
+    if (!isGadget)
+        metaObject = reinterpret_cast<const QObject*>(object)->metaObject();
+    if (inlineStorage)
+        report->types[metaObject].instances++;
+    else
+        add_object(report, metaObject);
+
+    for (int i = 0; i < metaObject->propertyCount(); i++) {
+        const QMetaProperty metaProp = metaObject->property(i);
+        const QVariant value = isGadget ? metaProp.readOnGadget(object) : metaProp.read(reinterpret_cast<const QObject*>(object));
+        measure_value(report, visited, metaProp.enclosingMetaObject(), value);
+    }
+}
+
+MemoryReport measure_memory(const void* object, const QMetaObject* metaObject)
+{
+    MemoryReport report;
+    QSet<const void*> visited;
+    measure_object(&report, &visited, object, metaObject, false);
+    return report;
+}
+
+static void move_value_objects(const QVariant& value, QThread* thread)
+{
+    const QMetaType metaType(value.userType());
+    if (metaType.flags().testFlag(QMetaType::PointerToQObject)) {
+        // Children follow their parent.
+        QObject* obj = value.value<QObject*>();
+        if (obj && !obj->parent())
+            obj->moveToThread(thread);
+        return;
+    }
+
+    if (metaType.flags().testFlag(QMetaType::PointerToGadget)) {
+        const void* gadget = *reinterpret_cast<void* const*>(value.constData());
+        if (gadget)
+            move_gadget_objects(gadget, metaType.metaObject(), thread);
+        return;
+    }
+
+    SharedGadgetKernel sharedKernel;
+    if (shared_gadget_kernel(metaType.id(), &sharedKernel)) {
+        const void* gadget = sharedKernel.get(value);
+        if (gadget)
+            move_gadget_objects(gadget, QMetaType(sharedKernel.gadgetPointerType).metaObject(), thread);
+        return;
+    }
+
+    GadgetArrayKernel gadgetKernel;
+    if (gadget_array_kernel(metaType.id(), &gadgetKernel)) {
+        const QMetaObject* elementMetaObject = gadgetKernel.metaObject;
+        gadgetKernel.visit(value, [elementMetaObject, thread] (const void* element) {
+            move_gadget_objects(element, elementMetaObject, thread);
+        });
+        return;
+    }
+
+    DictionaryKernel dictionaryKernel;
+    if (dictionary_kernel(metaType.id(), &dictionaryKernel)) {
+        if (dictionaryKernel.kind == DictionaryKernel::Value)
+            return;
+        const bool gadget = dictionaryKernel.kind == DictionaryKernel::Gadget;
+        const QMetaObject* valueMetaObject = QMetaType(dictionaryKernel.valueType).metaObject();
+        dictionaryKernel.write(value, [gadget, valueMetaObject, thread] (const void* element) -> QJsonValue {
+            if (gadget)
+                move_gadget_objects(element, valueMetaObject, thread);
+            else
+                move_value_objects(QVariant::fromValue(*reinterpret_cast<QObject* const*>(element)), thread);
+            return QJsonValue();
+        });
+        return;
+    }
+
+    if (value.canConvert<QVariantList>()) {
+        const LSequentialIterable it = value.value<LSequentialIterable>();
+        for (const QVariant& element : it) {
+            const QMetaType elementType(element.userType());
+            if (elementType.flags().testFlag(QMetaType::PointerToQObject)
+                    || elementType.flags().testFlag(QMetaType::PointerToGadget))
+                move_value_objects(element, thread);
+        }
+    }
+}
+
+///
+/// \brief move_gadget_objects moves the QObject's without a parent that are reachable
+/// from a gadget to thread. It must be called from the thread the objects live in.
+///
+void move_gadget_objects(const void* gadget, const QMetaObject* metaObject, QThread* thread)
+{
+    for (int i = 0; i < metaObject->propertyCount(); i++)
+        move_value_objects(metaObject->property(i).readOnGadget(gadget), thread);
+}
+
+///
+/// \brief emit_notify_signal emits signal on behalf of object. The first parameter
+/// receives value, converted to the type of the parameter; the others are default
+/// constructed. Signals with parameters of unknown types are not emitted.
+///
+void emit_notify_signal(QObject* object, const QMetaMethod& signal, const QVariant& value)
+{
+    const int count = signal.parameterCount();
+    QVector<QVariant> args;
+    args.reserve(count);
+    QVector<void*> argv(count + 1, nullptr);
+    for (int i = 0; i < count; i++) {
+        const int typeId = signal.parameterType(i);
+        if (typeId == QMetaType::QVariant) {
+            args.append(i == 0 ? value : QVariant());
+            argv[i + 1] = &args.last();
+            continue;
+        }
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        QVariant arg(QMetaType(typeId), nullptr);
+        if (i == 0 && value.userType() == typeId)
+            arg = value;
+        else if (i == 0 && value.canConvert(QMetaType(typeId))) {
+            QVariant converted = value;
+            if (converted.convert(QMetaType(typeId)))
+                arg = converted;
+        }
+#else
+        QVariant arg(typeId, nullptr);
+        if (i == 0 && value.userType() == typeId)
+            arg = value;
+        else if (i == 0 && value.canConvert(typeId)) {
+            QVariant converted = value;
+            if (converted.convert(typeId))
+                arg = converted;
+        }
+#endif
+        if (!arg.isValid())
+            return;
+        args.append(arg);
+        argv[i + 1] = args.last().data();
+    }
+
+    const QMetaObject* metaObject = signal.enclosingMetaObject();
+    QMetaObject::activate(object, metaObject, signal.methodIndex() - metaObject->methodOffset(), argv.data());
+}
+
+struct PolymorphicBase
+{
+    QString key;
+    QHash<QString, const QMetaObject*> subtypes;
+};
+
+Q_GLOBAL_STATIC(QReadWriteLock, s_polymorphicLock)
+typedef QHash<const QMetaObject*, PolymorphicBase> PolymorphicBases;
+Q_GLOBAL_STATIC(PolymorphicBases, s_polymorphicBases)
+typedef QHash<const QMetaObject*, QPair<QString, QString> > PolymorphicDiscriminators;
+Q_GLOBAL_STATIC(PolymorphicDiscriminators, s_polymorphicDiscriminators)
+static QBasicAtomicInt s_polymorphicTypes = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+void register_polymorphic_type(const QMetaObject* base, const QString& key, const QString& value, const QMetaObject* type)
+{
+    QWriteLocker locker(s_polymorphicLock());
+    PolymorphicBase& polymorphicBase = (*s_polymorphicBases())[base];
+    polymorphicBase.key = key;
+    polymorphicBase.subtypes.insert(value, type);
+    s_polymorphicDiscriminators->insert(type, qMakePair(key, value));
+    s_polymorphicTypes.ref();
+    s_registryGeneration.ref();
+}
+
+bool polymorphic_subtypes(const QMetaObject* base, QString* key, QHash<QString, const QMetaObject*>* subtypes)
+{
+    if (!s_polymorphicTypes.loadAcquire())
+        return false;
+
+    QReadLocker locker(s_polymorphicLock());
+    PolymorphicBases::const_iterator it = s_polymorphicBases->constFind(base);
+    if (it == s_polymorphicBases->constEnd())
+        return false;
+
+    *key = it->key;
+    *subtypes = it->subtypes;
+    return true;
+}
+
+bool polymorphic_discriminator(const QMetaObject* type, QString* key, QString* value)
+{
+    if (!s_polymorphicTypes.loadAcquire())
+        return false;
+
+    QReadLocker locker(s_polymorphicLock());
+    PolymorphicDiscriminators::const_iterator it = s_polymorphicDiscriminators->constFind(type);
+    if (it == s_polymorphicDiscriminators->constEnd())
+        return false;
+
+    *key = it->first;
+    *value = it->second;
+    return true;
+}
+
+QString Error::toString() const
+{
+    QString description;
+    switch (code) {
+    case ParseError:
+        description = QStringLiteral("invalid JSON");
+        break;
+    case UnknownType:
+        description = QStringLiteral("type is not known");
+        break;
+    case UnsupportedType:
+        description = QStringLiteral("type is not supported");
+        break;
+    case MissingAdder:
+        description = QStringLiteral("could not find add method");
+        break;
+    case AdderFailed:
+        description = QStringLiteral("failed to invoke add method");
+        break;
+    case ReadOnlyProperty:
+        description = QStringLiteral("prop must be writable to deserialize");
+        break;
+    case WriteFailed:
+        description = QStringLiteral("failed to write prop");
+        break;
+    case UnknownKey:
+        description = QStringLiteral("unknown key");
+        break;
+    case TypeMismatch:
+        description = QStringLiteral("type mismatch");
+        break;
+    case MissingRequired:
+        description = QStringLiteral("missing required prop %1").arg(property);
+        break;
+    case LimitExceeded:
+        description = QStringLiteral("%1 exceeded").arg(property);
+        break;
+    }
+
+    return QStringLiteral("%1: %2").arg(path.isEmpty() ? QStringLiteral("<root>") : path, description);
+}
+
+QString path_to_string(const Path& path)
+{
+    QString ret;
+    for (const PathElement& element : path) {
+        if (element.key) {
+            if (!ret.isEmpty())
+                ret.append(QLatin1Char('.'));
+            ret.append(*element.key);
+        }
+        else
+            ret.append(QStringLiteral("[%1]").arg(element.index));
+    }
+
+    return ret;
+}
+
+void LogRateLimiter::setEnabled(bool enabled, int maxPerSecond)
+{
+    m_enabled = enabled;
+    m_maxPerSecond = maxPerSecond;
+    m_count = 0;
+    m_window.invalidate();
+}
+
+bool LogRateLimiter::acquire()
+{
+    if (!m_window.isValid() || m_window.elapsed() >= 1000) {
+        m_window.start();
+        m_count = 0;
+    }
+
+    return m_count++ < m_maxPerSecond;
+}
+
+static inline bool is_json_space(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+JsonScanner::JsonScanner()
+{
+    reset();
+}
+
+void JsonScanner::feed(const char* data, qsizetype size)
+{
+    // Drop what was already returned, keeping the token being scanned.
+    const qsizetype keep = (m_state == InKey || m_state == InValue) ? m_tokenStart : m_pos;
+    if (keep > 0) {
+        m_buffer.remove(0, keep);
+        m_pos -= keep;
+        m_tokenStart -= keep;
+    }
+
+    m_buffer.append(data, size);
+}
+
+JsonScanner::Status JsonScanner::next()
+{
+    if (m_state == Failed)
+        return Error;
+
+    const char* data = m_buffer.constData();
+    const qsizetype size = m_buffer.size();
+    while (m_pos < size) {
+        const char c = data[m_pos];
+        switch (m_state) {
+        case BeforeRoot:
+            if (is_json_space(c)) {
+                m_pos++;
+                break;
+            }
+            if (c == '{')
+                m_rootIsArray = false;
+            else if (c == '[')
+                m_rootIsArray = true;
+            else
+                return fail(QStringLiteral("Root must be an object or an array"));
+            m_pos++;
+            m_first = true;
+            m_state = m_rootIsArray ? BeforeValue : BeforeKey;
+            break;
+        case BeforeKey:
+            if (is_json_space(c)) {
+                m_pos++;
+                break;
+            }
+            if (c == '}' && m_first) {
+                m_pos++;
+                m_state = Done;
+                return Finished;
+            }
+            if (c != '"')
+                return fail(QStringLiteral("Expected a key"));
+            m_tokenStart = m_pos++;
+            m_escape = false;
+            m_state = InKey;
+            break;
+        case InKey:
+            m_pos++;
+            if (m_escape)
+                m_escape = false;
+            else if (c == '\\')
+                m_escape = true;
+            else if (c == '"') {
+                m_key = m_buffer.mid(m_tokenStart, m_pos - m_tokenStart);
+                m_state = AfterKey;
+            }
+            break;
+        case AfterKey:
+            if (is_json_space(c)) {
+                m_pos++;
+                break;
+            }
+            if (c != ':')
+                return fail(QStringLiteral("Expected ':'"));
+            m_pos++;
+            m_state = BeforeValue;
+            break;
+        case BeforeValue:
+            if (is_json_space(c)) {
+                m_pos++;
+                break;
+            }
+            if (c == ']' && m_rootIsArray && m_first) {
+                m_pos++;
+                m_state = Done;
+                return Finished;
+            }
+            if (c == ',' || c == ':' || c == '}' || c == ']')
+                return fail(QStringLiteral("Expected a value"));
+            m_tokenStart = m_pos;
+            m_depth = 0;
+            m_inString = false;
+            m_escape = false;
+            m_state = InValue;
+            break;
+        case InValue:
+            if (m_inString) {
+                m_pos++;
+                if (m_escape)
+                    m_escape = false;
+                else if (c == '\\')
+                    m_escape = true;
+                else if (c == '"') {
+                    m_inString = false;
+                    if (m_depth == 0)
+                        return completeValue();
+                }
+                break;
+            }
+            if (c == '"') {
+                m_pos++;
+                m_inString = true;
+                break;
+            }
+            if (c == '{' || c == '[') {
+                m_pos++;
+                m_depth++;
+                break;
+            }
+            if (c == '}' || c == ']') {
+                // A scalar terminated by the end of the root.
+                if (m_depth == 0)
+                    return completeValue();
+                m_pos++;
+                if (--m_depth == 0)
+                    return completeValue();
+                break;
+            }
+            if (m_depth == 0 && (c == ',' || is_json_space(c)))
+                return completeValue();
+            m_pos++;
+            break;
+        case AfterValue:
+            if (is_json_space(c)) {
+                m_pos++;
+                break;
+            }
+            if (c == ',') {
+                m_pos++;
+                m_first = false;
+                m_state = m_rootIsArray ? BeforeValue : BeforeKey;
+                break;
+            }
+            if (c == (m_rootIsArray ? ']' : '}')) {
+                m_pos++;
+                m_state = Done;
+                return Finished;
+            }
+            return fail(QStringLiteral("Expected ',' or the end of the root"));
+        case Done:
+            if (is_json_space(c)) {
+                m_pos++;
+                break;
+            }
+            return fail(QStringLiteral("Unexpected data after the end of the document"));
+        case Failed:
+            return Error;
+        }
+    }
+
+    return m_state == Done ? Finished : NeedMoreData;
+}
 
-Q_LOGGING_CATEGORY(lserializer, "lserializer")
+void JsonScanner::reset()
+{
+    m_buffer.clear();
+    m_pos = 0;
+    m_tokenStart = 0;
+    m_state = BeforeRoot;
+    m_rootIsArray = false;
+    m_first = true;
+    m_depth = 0;
+    m_inString = false;
+    m_escape = false;
+    m_key.clear();
+    m_value.clear();
+    m_errorString.clear();
+}
 
-namespace lqo {
+JsonScanner::Status JsonScanner::completeValue()
+{
+    m_value = m_buffer.mid(m_tokenStart, m_pos - m_tokenStart);
+    m_state = AfterValue;
+    return Value;
+}
+
+JsonScanner::Status JsonScanner::fail(const QString& errorString)
+{
+    m_errorString = errorString;
+    m_state = Failed;
+    return Error;
+}
+
+// Nesting accepted by QJsonDocument, so that both accept the same documents.
+static const int s_maxReaderDepth = 1024;
+
+static void append_utf8(QByteArray* utf8, uint codePoint)
+{
+    if (codePoint < 0x80)
+        utf8->append(char(codePoint));
+    else if (codePoint < 0x800) {
+        utf8->append(char(0xc0 | (codePoint >> 6)));
+        utf8->append(char(0x80 | (codePoint & 0x3f)));
+    }
+    else if (codePoint < 0x10000) {
+        utf8->append(char(0xe0 | (codePoint >> 12)));
+        utf8->append(char(0x80 | ((codePoint >> 6) & 0x3f)));
+        utf8->append(char(0x80 | (codePoint & 0x3f)));
+    }
+    else {
+        utf8->append(char(0xf0 | (codePoint >> 18)));
+        utf8->append(char(0x80 | ((codePoint >> 12) & 0x3f)));
+        utf8->append(char(0x80 | ((codePoint >> 6) & 0x3f)));
+        utf8->append(char(0x80 | (codePoint & 0x3f)));
+    }
+}
+
+static inline bool is_json_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+JsonReader::JsonReader(const char* data, qsizetype size) :
+    m_data(data)
+  , m_size(size)
+  , m_pos(0)
+  , m_depth(0)
+  , m_first(false)
+  , m_error(false) {}
+
+///
+/// \brief JsonReader::peek returns the type of the next value, without reading it.
+///
+JsonReader::Type JsonReader::peek()
+{
+    if (m_error)
+        return Invalid;
+
+    skipSpace();
+    if (m_pos >= m_size) {
+        fail();
+        return Invalid;
+    }
+
+    const char c = m_data[m_pos];
+    switch (c) {
+    case '{':
+        return Object;
+    case '[':
+        return Array;
+    case '"':
+        return String;
+    case 't':
+    case 'f':
+        return Bool;
+    case 'n':
+        return Null;
+    default:
+        if (c == '-' || is_json_digit(c))
+            return Number;
+        fail();
+        return Invalid;
+    }
+}
+
+///
+/// \brief JsonReader::readScalar reads the next value, which must not be a container.
+/// Returns QJsonValue::Undefined on error.
+///
+QJsonValue JsonReader::readScalar()
+{
+    switch (peek()) {
+    case Null:
+        if (readLiteral("null", 4))
+            return QJsonValue(QJsonValue::Null);
+        break;
+    case Bool: {
+        const bool value = m_data[m_pos] == 't';
+        if (readLiteral(value ? "true" : "false", value ? 4 : 5))
+            return QJsonValue(value);
+        break;
+    }
+    case Number: {
+        double value;
+        if (readNumber(&value))
+            return QJsonValue(value);
+        break;
+    }
+    case String: {
+        QByteArray utf8;
+        if (readString(&utf8))
+            return QJsonValue(QString::fromUtf8(utf8));
+        break;
+    }
+    default:
+        fail();
+        break;
+    }
+
+    return QJsonValue(QJsonValue::Undefined);
+}
+
+///
+/// \brief JsonReader::readString reads the next string, decoding escapes. utf8 may be
+/// nullptr to skip it. Strings that are not valid UTF-8 are malformed.
+///
+bool JsonReader::readString(QByteArray* utf8)
+{
+    skipSpace();
+    if (m_error || m_pos >= m_size || m_data[m_pos] != '"')
+        return fail();
+
+    QByteArray decoded;
+    qsizetype spanStart = ++m_pos;
+    for (;;) {
+        if (m_pos >= m_size)
+            return fail();
+
+        const uchar c = uchar(m_data[m_pos]);
+        if (c == '"')
+            break;
+        if (c < 0x20)
+            return fail();
+        if (c != '\\') {
+            m_pos++;
+            continue;
+        }
+
+        decoded.append(m_data + spanStart, int(m_pos - spanStart));
+        if (++m_pos >= m_size)
+            return fail();
+
+        const char escape = m_data[m_pos++];
+        switch (escape) {
+        case '"':
+        case '\\':
+        case '/':
+            decoded.append(escape);
+            break;
+        case 'b':
+            decoded.append('\b');
+            break;
+        case 'f':
+            decoded.append('\f');
+            break;
+        case 'n':
+            decoded.append('\n');
+            break;
+        case 'r':
+            decoded.append('\r');
+            break;
+        case 't':
+            decoded.append('\t');
+            break;
+        case 'u': {
+            uint codePoint;
+            if (!readHex(&codePoint))
+                return fail();
+            if (codePoint >= 0xd800 && codePoint < 0xdc00 && m_size - m_pos >= 6
+                    && m_data[m_pos] == '\\' && m_data[m_pos + 1] == 'u') {
+                const qsizetype pos = m_pos;
+                m_pos += 2;
+                uint low;
+                if (readHex(&low) && low >= 0xdc00 && low < 0xe000)
+                    codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                else
+                    m_pos = pos;
+            }
+            // Unpaired surrogates cannot be encoded, like in QString::toUtf8().
+            if (codePoint >= 0xd800 && codePoint < 0xe000)
+                codePoint = 0xfffd;
+            append_utf8(&decoded, codePoint);
+            break;
+        }
+        default:
+            return fail();
+        }
+        spanStart = m_pos;
+    }
+
+    decoded.append(m_data + spanStart, int(m_pos - spanStart));
+    m_pos++;
+    if (!is_valid_utf8(decoded))
+        return fail();
+
+    if (utf8)
+        utf8->swap(decoded);
+    m_first = false;
+    return true;
+}
+
+bool JsonReader::beginObject()
+{
+    return beginContainer('{');
+}
+
+///
+/// \brief JsonReader::nextMember reads the key of the next member of the current
+/// object; its value must be read next. Returns false at the end of the object or on
+/// error. key may be nullptr.
+///
+bool JsonReader::nextMember(QByteArray* key)
+{
+    if (!endContainer('}'))
+        return false;
+
+    if (!readString(key))
+        return false;
+
+    skipSpace();
+    if (m_pos >= m_size || m_data[m_pos] != ':')
+        return fail();
+    m_pos++;
+    return true;
+}
+
+bool JsonReader::beginArray()
+{
+    return beginContainer('[');
+}
+
+///
+/// \brief JsonReader::nextElement moves to the next element of the current array,
+/// which must be read next. Returns false at the end of the array or on error.
+///
+bool JsonReader::nextElement()
+{
+    return endContainer(']');
+}
+
+bool JsonReader::skipValue()
+{
+    switch (peek()) {
+    case Object:
+        if (!beginObject())
+            return false;
+        while (nextMember(nullptr))
+            if (!skipValue())
+                return false;
+        return !m_error;
+    case Array:
+        if (!beginArray())
+            return false;
+        while (nextElement())
+            if (!skipValue())
+                return false;
+        return !m_error;
+    case Invalid:
+        return false;
+    default:
+        return readScalar().type() != QJsonValue::Undefined;
+    }
+}
+
+///
+/// \brief JsonReader::peekMember returns the value of the member key of the next
+/// object, without moving past it: a string, null if the value is not a string, or
+/// undefined if there is no such member.
+///
+QJsonValue JsonReader::peekMember(const QByteArray& key) const
+{
+    JsonReader reader(*this);
+    QByteArray name;
+    if (!reader.beginObject())
+        return QJsonValue(QJsonValue::Undefined);
+
+    while (reader.nextMember(&name)) {
+        if (name == key)
+            return reader.peek() == String ? reader.readScalar() : QJsonValue(QJsonValue::Null);
+        if (!reader.skipValue())
+            break;
+    }
+
+    return QJsonValue(QJsonValue::Undefined);
+}
+
+///
+/// \brief JsonReader::atEnd returns whether only whitespace is left.
+///
+bool JsonReader::atEnd()
+{
+    skipSpace();
+    return !m_error && m_pos == m_size;
+}
+
+void JsonReader::skipSpace()
+{
+    while (m_pos < m_size && is_json_space(m_data[m_pos]))
+        m_pos++;
+}
+
+bool JsonReader::fail()
+{
+    m_error = true;
+    return false;
+}
+
+bool JsonReader::readLiteral(const char* literal, int size)
+{
+    if (m_size - m_pos < size || qstrncmp(m_data + m_pos, literal, uint(size)) != 0)
+        return fail();
+
+    m_pos += size;
+    m_first = false;
+    return true;
+}
+
+bool JsonReader::readNumber(double* value)
+{
+    const qsizetype start = m_pos;
+    if (m_pos < m_size && m_data[m_pos] == '-')
+        m_pos++;
+    if (m_pos >= m_size || !is_json_digit(m_data[m_pos]))
+        return fail();
+    if (m_data[m_pos] == '0')
+        m_pos++;
+    else
+        while (m_pos < m_size && is_json_digit(m_data[m_pos]))
+            m_pos++;
+
+    if (m_pos < m_size && m_data[m_pos] == '.') {
+        if (++m_pos >= m_size || !is_json_digit(m_data[m_pos]))
+            return fail();
+        while (m_pos < m_size && is_json_digit(m_data[m_pos]))
+            m_pos++;
+    }
+
+    if (m_pos < m_size && (m_data[m_pos] == 'e' || m_data[m_pos] == 'E')) {
+        if (++m_pos < m_size && (m_data[m_pos] == '+' || m_data[m_pos] == '-'))
+            m_pos++;
+        if (m_pos >= m_size || !is_json_digit(m_data[m_pos]))
+            return fail();
+        while (m_pos < m_size && is_json_digit(m_data[m_pos]))
+            m_pos++;
+    }
+
+    bool ok;
+    *value = QByteArray::fromRawData(m_data + start, int(m_pos - start)).toDouble(&ok);
+    if (!ok)
+        return fail();
+
+    m_first = false;
+    return true;
+}
+
+bool JsonReader::readHex(uint* value)
+{
+    if (m_size - m_pos < 4)
+        return false;
+
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        const char c = m_data[m_pos + i];
+        if (!is_json_digit(c) && !(c >= 'a' && c <= 'f') && !(c >= 'A' && c <= 'F'))
+            return false;
+        *value = (*value << 4) | uint(hex_value(c));
+    }
+
+    m_pos += 4;
+    return true;
+}
+
+bool JsonReader::beginContainer(char c)
+{
+    if (peek() == Invalid || m_data[m_pos] != c || m_depth >= s_maxReaderDepth)
+        return fail();
+
+    m_pos++;
+    m_depth++;
+    m_first = true;
+    return true;
+}
+
+///
+/// \brief JsonReader::endContainer consumes the closing character c, returning false,
+/// or the comma before the next value of the container.
+///
+bool JsonReader::endContainer(char c)
+{
+    if (m_error)
+        return false;
+
+    skipSpace();
+    if (m_pos >= m_size)
+        return fail();
+
+    if (m_data[m_pos] == c) {
+        m_pos++;
+        m_depth--;
+        // The container is a complete value of its parent.
+        m_first = false;
+        return false;
+    }
+
+    if (!m_first) {
+        if (m_data[m_pos] != ',')
+            return fail();
+        m_pos++;
+    }
+    return true;
+}
 
 Serializer::Serializer(const QHash<QString, QSharedPointer<Stringifier>>& memberStringifiers,
                        const TypeStringifiersMap& typeStringifiers) :
     m_memberStringifiers(memberStringifiers)
   , m_typeStringifiers(typeStringifiers) {}
 
+template<class T, class J>
+static QJsonArray serialize_typed_list(const QList<T>& list)
+{
+    QJsonArray ret;
+    for (const T& value : list)
+        ret.append(QJsonValue(static_cast<J>(value)));
+    return ret;
+}
+
+///
+/// \brief serialize_typed_array serializes QList<T> and QList<QList<T>> without
+/// wrapping each element in a QVariant. J is the type used to build the QJsonValue.
+///
+template<class T, class J>
+static bool serialize_typed_array(const QVariant& value, QJsonArray* array)
+{
+    if (value.userType() == qMetaTypeId<QList<T> >()) {
+        *array = serialize_typed_list<T, J>(*reinterpret_cast<const QList<T>*>(value.constData()));
+        return true;
+    }
+
+    if (value.userType() == qMetaTypeId<QList<QList<T> > >()) {
+        const QList<QList<T> >& list = *reinterpret_cast<const QList<QList<T> >*>(value.constData());
+        for (const QList<T>& row : list)
+            array->append(serialize_typed_list<T, J>(row));
+        return true;
+    }
+
+    return false;
+}
+
 QJsonValue Serializer::serializeObject(const void* object, const QMetaObject* metaObj)
 {
+    StatsScope statsScope(m_statsCollector.data(), metaObj, &m_statsScope);
     QJsonObject json;
     bool isGadget = !metaObj->inherits(&QObject::staticMetaObject);
 
     for (int i = 0; i < metaObj->propertyCount(); ++i) {
         QMetaProperty metaProp = metaObj->property(i);
         QVariant value;
+        L_INSTR_COUNT(m_instrumentation, metaObj, propertyReads);
+        L_INSTR_COUNT(m_instrumentation, metaObj, variantConstructions);
         if (isGadget)
             value = metaProp.readOnGadget(object);
         else
@@ -58,17 +2903,294 @@ QJsonValue Serializer::serializeObject(const void* object, const QMetaObject* me
         json[metaProp.name()] = jsonValue;
     }
 
+    QString typeKey;
+    QString typeName;
+    if (polymorphic_discriminator(metaObj, &typeKey, &typeName))
+        json[typeKey] = typeName;
+
     return json;
 }
 
+void Serializer::writeObject(JsonWriter& writer, const void* object, const QMetaObject* metaObj)
+{
+    StatsScope statsScope(m_statsCollector.data(), metaObj, &m_statsScope);
+    bool isGadget = !metaObj->inherits(&QObject::staticMetaObject);
+
+    writer.beginObject();
+    for (int i = 0; i < metaObj->propertyCount(); ++i) {
+        QMetaProperty metaProp = metaObj->property(i);
+        QVariant value;
+        L_INSTR_COUNT(m_instrumentation, metaObj, propertyReads);
+        L_INSTR_COUNT(m_instrumentation, metaObj, variantConstructions);
+        if (isGadget)
+            value = metaProp.readOnGadget(object);
+        else
+            value = metaProp.read(reinterpret_cast<const QObject*>(object));
+
+        // This is the case of objectName. Only add it to the json if it is not empty.
+        if (metaProp.enclosingMetaObject() == &QObject::staticMetaObject && value.toString().isEmpty())
+            continue;
+
+        writeValue(writer, metaProp.name(), value, metaProp.enclosingMetaObject());
+    }
+    QString typeKey;
+    QString typeName;
+    if (polymorphic_discriminator(metaObj, &typeKey, &typeName)) {
+        writer.writeKey(typeKey);
+        writer.writeValue(typeName);
+    }
+    writer.endObject();
+}
+
+///
+/// \brief Serializer::writeValue writes a value, preceded by its key when propName is
+/// not null. Objects reachable through pointers and arrays are written directly, so
+/// RawJson values are spliced at any depth; other values go through serializeValue.
+///
+void Serializer::writeValue(JsonWriter& writer, const char* propName, const QVariant& value, const QMetaObject* metaObject)
+{
+    const QMetaType metaType(value.userType());
+    if (metaType.id() == qMetaTypeId<RawJson>()) {
+        const RawJson& raw = *reinterpret_cast<const RawJson*>(value.constData());
+        if (raw.isNull()) {
+            // Members are omitted, array elements keep their index.
+            if (!propName)
+                writer.writeValue(QJsonValue::Null);
+            return;
+        }
+
+        QByteArray json = raw.toJson();
+        if (m_validateRawJson) {
+            QJsonParseError error;
+            QJsonDocument::fromJson("[" + json + "]", &error);
+            if (error.error != QJsonParseError::NoError) {
+                if (m_statsCollector)
+                    m_statsCollector->recordWarning(metaObject);
+                json = QByteArrayLiteral("null");
+            }
+        }
+
+        if (propName)
+            writer.writeKey(propName);
+        writer.writeRaw(json);
+        return;
+    }
+
+    if (metaType.flags().testFlag(QMetaType::PointerToQObject)) {
+        if (propName)
+            writer.writeKey(propName);
+        const QObject* obj = value.value<QObject*>();
+        if (!obj)
+            writer.writeValue(QJsonValue::Null);
+        else
+            writeObject(writer, obj, obj->metaObject());
+        return;
+    }
+
+    if (metaType.flags().testFlag(QMetaType::PointerToGadget)) {
+        if (propName)
+            writer.writeKey(propName);
+        const void* gadget = *reinterpret_cast<void* const*>(value.constData());
+        if (!gadget)
+            writer.writeValue(QJsonValue::Null);
+        else
+            writeObject(writer, gadget, metaType.metaObject());
+        return;
+    }
+
+    GadgetArrayKernel kernel;
+    if (gadget_array_kernel(metaType.id(), &kernel)) {
+        if (propName)
+            writer.writeKey(propName);
+        writer.beginArray();
+        const QMetaObject* elementMetaObject = kernel.metaObject;
+        kernel.visit(value, [this, &writer, elementMetaObject] (const void* element) {
+            writeObject(writer, element, elementMetaObject);
+        });
+        writer.endArray();
+        return;
+    }
+
+    // UTF-8 strings are copied without going through QString.
+    if (metaType.id() == QMetaType::QByteArray
+            && !find_stringifier(metaObject, propName, metaType, m_memberStringifiers, m_typeStringifiers)) {
+        const QByteArray& utf8 = *reinterpret_cast<const QByteArray*>(value.constData());
+        if (utf8.isNull() && propName)
+            return;
+        if (propName)
+            writer.writeKey(propName);
+        writer.writeUtf8(utf8);
+        return;
+    }
+
+    // Arrays of pointers, e.g. QList<Item*>, and of raw fragments.
+    const QByteArray typeName(metaType.name());
+    if ((typeName.startsWith("QList<") && typeName.endsWith("*>")) || metaType.id() == qMetaTypeId<QList<RawJson> >()) {
+        if (propName)
+            writer.writeKey(propName);
+        writer.beginArray();
+        const LSequentialIterable it = value.value<LSequentialIterable>();
+        for (const QVariant& element : it) {
+            L_INSTR_COUNT(m_instrumentation, metaObject, variantConstructions);
+            writeValue(writer, nullptr, element, metaObject);
+        }
+        writer.endArray();
+        return;
+    }
+
+    const QJsonValue jsonValue = serializeValue(propName, value, metaObject);
+    if (jsonValue.isUndefined() && propName)
+        return;
+    if (propName)
+        writer.writeKey(propName);
+    writer.writeValue(jsonValue);
+}
+
 QJsonArray Serializer::serializeArray(const LSequentialIterable& it, const QMetaObject* metaObject)
 {
     QJsonArray ret;
-    for (const QVariant& variant : it)
+    for (const QVariant& variant : it) {
+        L_INSTR_COUNT(m_instrumentation, metaObject, variantConstructions);
         ret.append(serializeValue(nullptr, variant, metaObject));
+    }
     return ret;
 }
 
+///
+/// \brief Serializer::hashObject feeds the properties of object to hasher, in the order
+/// of the metaObject. Values are hashed as they would be serialized, but without
+/// building the JSON.
+///
+void Serializer::hashObject(Hasher& hasher, const void* object, const QMetaObject* metaObj)
+{
+    const bool isGadget = !metaObj->inherits(&QObject::staticMetaObject);
+
+    hash_type(hasher, QJsonValue::Object);
+    quint64 count = 0;
+    for (int i = 0; i < metaObj->propertyCount(); ++i) {
+        QMetaProperty metaProp = metaObj->property(i);
+        QVariant value;
+        L_INSTR_COUNT(m_instrumentation, metaObj, propertyReads);
+        if (isGadget)
+            value = metaProp.readOnGadget(object);
+        else
+            value = metaProp.read(reinterpret_cast<const QObject*>(object));
+
+        // This is the case of objectName, which is only serialized when not empty.
+        if (metaProp.enclosingMetaObject() == &QObject::staticMetaObject && value.toString().isEmpty())
+            continue;
+
+        const char* name = metaProp.name();
+        hasher.add(name, qsizetype(qstrlen(name)) + 1);
+        hashValue(hasher, name, value, metaProp.enclosingMetaObject());
+        count++;
+    }
+    hasher.add(count);
+}
+
+void Serializer::hashValue(Hasher& hasher, const char* propName, const QVariant& value, const QMetaObject* metaObject)
+{
+    if (value.isNull()) {
+        hash_type(hasher, QJsonValue::Undefined);
+        return;
+    }
+
+    const QMetaType metaType(value.userType());
+    switch (metaType.id()) {
+    case QMetaType::QString:
+        hash_string(hasher, value.toString());
+        return;
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::Long:
+    case QMetaType::LongLong:
+    case QMetaType::Float:
+    case QMetaType::Double:
+    case QMetaType::Short:
+    case QMetaType::ULong:
+    case QMetaType::ULongLong:
+    case QMetaType::UShort:
+        hash_double(hasher, value.toDouble());
+        return;
+    case QMetaType::Bool:
+        hash_bool(hasher, value.toBool());
+        return;
+    default:
+        break;
+    }
+
+    if (metaType.id() == qMetaTypeId<RawJson>()) {
+        const QByteArray json = reinterpret_cast<const RawJson*>(value.constData())->toJson();
+        hash_type(hasher, QJsonValue::Undefined);
+        hasher.add(quint64(json.size()));
+        hasher.add(json.constData(), json.size());
+        return;
+    }
+
+    if (metaType.flags().testFlag(QMetaType::PointerToQObject)) {
+        const QObject* obj = value.value<QObject*>();
+        if (!obj)
+            hash_type(hasher, QJsonValue::Null);
+        else
+            hashObject(hasher, obj, obj->metaObject());
+        return;
+    }
+
+    if (metaType.flags().testFlag(QMetaType::PointerToGadget)) {
+        const void* gadget = *reinterpret_cast<void* const*>(value.constData());
+        if (!gadget)
+            hash_type(hasher, QJsonValue::Null);
+        else
+            hashObject(hasher, gadget, metaType.metaObject());
+        return;
+    }
+
+    SharedGadgetKernel sharedKernel;
+    if (shared_gadget_kernel(metaType.id(), &sharedKernel)) {
+        const void* gadget = sharedKernel.get(value);
+        if (!gadget)
+            hash_type(hasher, QJsonValue::Null);
+        else
+            hashObject(hasher, gadget, QMetaType(sharedKernel.gadgetPointerType).metaObject());
+        return;
+    }
+
+    GadgetArrayKernel kernel;
+    if (gadget_array_kernel(metaType.id(), &kernel)) {
+        hash_type(hasher, QJsonValue::Array);
+        quint64 count = 0;
+        const QMetaObject* elementMetaObject = kernel.metaObject;
+        kernel.visit(value, [this, &hasher, &count, elementMetaObject] (const void* element) {
+            hashObject(hasher, element, elementMetaObject);
+            count++;
+        });
+        hasher.add(count);
+        return;
+    }
+
+    // Sequences are walked element by element; anything else, including dictionaries
+    // and stringified types, is hashed through its JSON value.
+    ColumnarKernel columnarKernel;
+    DictionaryKernel dictionaryKernel;
+    if (metaType.id() == QMetaType::QVariantList
+            || (value.canConvert<QVariantList>()
+                && !columnar_kernel(metaType.id(), &columnarKernel)
+                && !dictionary_kernel(metaType.id(), &dictionaryKernel)
+                && !find_stringifier(metaObject, propName, metaType, m_memberStringifiers, m_typeStringifiers))) {
+        hash_type(hasher, QJsonValue::Array);
+        quint64 count = 0;
+        const LSequentialIterable it = value.value<LSequentialIterable>();
+        for (const QVariant& element : it) {
+            hashValue(hasher, nullptr, element, metaObject);
+            count++;
+        }
+        hasher.add(count);
+        return;
+    }
+
+    hash_json_value(hasher, serializeValue(propName, value, metaObject));
+}
+
 QJsonValue Serializer::serializeValue(const char* propName, const QVariant& value, const QMetaObject* metaObject)
 {
     if (value.isNull())
@@ -89,10 +3211,11 @@ QJsonValue Serializer::serializeValue(const char* propName, const QVariant& valu
         if (value.toString().isNull())
             return QJsonValue::Undefined;
         return QJsonValue(value.toString());
+    case QMetaType::LongLong:
+        return QJsonValue(value.toLongLong());
     case QMetaType::Int:
     case QMetaType::UInt:
     case QMetaType::Long:
-    case QMetaType::LongLong:
     case QMetaType::Float:
     case QMetaType::Double:
     case QMetaType::Short:
@@ -110,6 +3233,9 @@ QJsonValue Serializer::serializeValue(const char* propName, const QVariant& valu
             return serializeObject(obj, obj->metaObject());
         }
     default:
+        if (metaType.id() == qMetaTypeId<RawJson>())
+            return reinterpret_cast<const RawJson*>(value.constData())->value();
+
         if (metaType.flags().testFlag(QMetaType::PointerToQObject)) {
             if (!value.value<QObject*>())
                 return QJsonValue::Null;
@@ -133,23 +3259,90 @@ QJsonValue Serializer::serializeValue(const char* propName, const QVariant& valu
                 return serializeObject(gadget, metaType.metaObject());
         }
 
-        break;
-    }
+        {
+            GadgetArrayKernel kernel;
+            if (gadget_array_kernel(metaType.id(), &kernel)) {
+                QJsonArray array;
+                const QMetaObject* elementMetaObject = kernel.metaObject;
+                kernel.visit(value, [this, &array, elementMetaObject] (const void* element) {
+                    array.append(serializeObject(element, elementMetaObject));
+                });
+                return array;
+            }
+
+            SharedGadgetKernel sharedKernel;
+            if (shared_gadget_kernel(metaType.id(), &sharedKernel)) {
+                const void* gadget = sharedKernel.get(value);
+                if (!gadget)
+                    return QJsonValue::Null;
+                return serializeObject(gadget, QMetaType(sharedKernel.gadgetPointerType).metaObject());
+            }
+
+            ColumnarKernel columnarKernel;
+            if (columnar_kernel(metaType.id(), &columnarKernel)) {
+                const Columns* columns = columnarKernel.columns(value);
+                QJsonArray array;
+                for (int row = 0; row < columns->rowCount(); row++) {
+                    if (columns->isNull(row)) {
+                        array.append(QJsonValue::Null);
+                        continue;
+                    }
+
+                    QJsonObject object;
+                    for (int column = 0; column < columns->columnCount(); column++) {
+                        const Columns::Column& c = columns->column(column);
+                        switch (c.type) {
+                        case Columns::IntColumn:
+                            object.insert(c.name, QJsonValue(c.ints.at(row)));
+                            break;
+                        case Columns::DoubleColumn:
+                            object.insert(c.name, c.doubles.at(row));
+                            break;
+                        case Columns::BoolColumn:
+                            object.insert(c.name, c.bools.at(row));
+                            break;
+                        case Columns::StringColumn:
+                            object.insert(c.name, columns->string(column, row).toString());
+                            break;
+                        }
+                    }
+                    array.append(object);
+                }
+                return array;
+            }
 
-    if (metaObject) {
-        const int classInfoIndex = metaObject->indexOfClassInfo(propName);
-        if (classInfoIndex >= 0) {
-            const QString stringifierName = QString(metaObject->classInfo(classInfoIndex).value());
-            if (m_memberStringifiers.contains(stringifierName)) {
-                auto stringifier = m_memberStringifiers.value(stringifierName);
-                if (stringifier)
-                    return stringifier->stringify(value);
+            DictionaryKernel dictionaryKernel;
+            if (dictionary_kernel(metaType.id(), &dictionaryKernel)) {
+                const bool gadget = dictionaryKernel.kind == DictionaryKernel::Gadget;
+                const QMetaObject* valueMetaObject = QMetaType(dictionaryKernel.valueType).metaObject();
+                return dictionaryKernel.write(value, [this, gadget, valueMetaObject] (const void* element) -> QJsonValue {
+                    if (gadget)
+                        return serializeObject(element, valueMetaObject);
+                    const QObject* obj = *reinterpret_cast<const QObject* const*>(element);
+                    if (!obj)
+                        return QJsonValue::Null;
+                    return serializeObject(obj, obj->metaObject());
+                });
             }
+
+            QJsonArray array;
+            if (serialize_typed_array<int, double>(value, &array)
+                    || serialize_typed_array<long, double>(value, &array)
+                    || serialize_typed_array<float, double>(value, &array)
+                    || serialize_typed_array<double, double>(value, &array)
+                    || serialize_typed_array<bool, bool>(value, &array)
+                    || serialize_typed_array<QString, QString>(value, &array))
+                return array;
         }
+
+        break;
     }
+
     Stringifier* stringifier = find_stringifier(metaObject, propName, metaType, m_memberStringifiers, m_typeStringifiers);
     if (stringifier)
         return stringifier->stringify(value);
+    if (metaType.id() == QMetaType::QByteArray)
+        return QJsonValue(QString::fromUtf8(*reinterpret_cast<const QByteArray*>(value.constData())));
     if (value.canConvert<QVariantList>())
         return serializeArray(value.value<LSequentialIterable>(), metaObject);
     if (value.canConvert<QVariantHash>())
@@ -159,6 +3352,8 @@ QJsonValue Serializer::serializeValue(const char* propName, const QVariant& valu
     if (value.canConvert<QString>())
         return QJsonValue(value.toString());
 
+    if (m_statsCollector)
+        m_statsCollector->recordWarning(metaObject);
     qCDebug(lserializer) << "Unable to serialize type:" << metaType.name();
     return QJsonValue();
 }
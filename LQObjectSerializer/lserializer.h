@@ -38,6 +38,24 @@
 #include <QMutex>
 #include <QMetaMethod>
 #include <QDebug>
+#include <QSharedPointer>
+#include <QScopedPointer>
+#include <QThreadStorage>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QThread>
+#include <QDeadlineTimer>
+#include <QAbstractListModel>
+#include <QPointer>
+#include <QSet>
+#include <QIODevice>
+
+#include <functional>
+#include <type_traits>
+#include <vector>
 
 #if QT_VERSION < QT_VERSION_CHECK(6, 11, 0)
 #define L_SUPPORTS_QSEQUENTIALITERABLE
@@ -52,6 +70,14 @@ using LSequentialIterable = QSequentialIterable;
 using LSequentialIterable = QMetaSequence::Iterable;
 #endif
 
+// LByteArrayView is QByteArrayView where available.
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <QByteArrayView>
+using LByteArrayView = QByteArrayView;
+#else
+using LByteArrayView = const QByteArray&;
+#endif
+
 #include "../deps/lqtutils/lqtutils_prop.h"
 #include "../deps/lqtutils/lqtutils_string.h"
 
@@ -62,546 +88,3270 @@ Q_DECLARE_LOGGING_CATEGORY(lserializer)
     public:                                                                            \
     Q_INVOKABLE void add_##name(void* o) { m_##name.append(reinterpret_cast<type>(o)); }
 
+#ifdef INSTRUMENT_LQOBJECTSERIALIZER
+#define L_INSTR_CALL(instr) lqo::InstrumentationCall lqo_instr_call(instr)
+#define L_INSTR_COUNT(instr, metaObject, counter) (instr).count(metaObject, &lqo::Counters::counter)
+#else
+#define L_INSTR_CALL(instr)
+#define L_INSTR_COUNT(instr, metaObject, counter)
+#endif
+
 class QObject;
 
 namespace lqo {
 
 ///
-/// \brief The LStringifier class is an interface for objects used to automatically
-/// stringify or destringify objects when serializing/deserializing.
+/// \brief The Counters struct holds the number of relevant operations performed
+/// while serializing or deserializing. Counters are only collected when the library
+/// is built with INSTRUMENT_LQOBJECTSERIALIZER defined, otherwise they are always 0.
 ///
-class Stringifier
+struct Counters
 {
-public:
-    virtual ~Stringifier() {}
-    virtual QString stringify(const QVariant&) { return QString(); }
-    virtual QVariant destringify(const QString&) { return QVariant(); }
+    quint64 allocations = 0;
+    quint64 instantiations = 0;
+    quint64 variantConstructions = 0;
+    quint64 propertyReads = 0;
+    quint64 propertyWrites = 0;
+    quint64 methodInvocations = 0;
+
+    Counters& operator+=(const Counters& other);
 };
-typedef QHash<QString, QSharedPointer<Stringifier>> MemberStringifiersMap;
-typedef QHash<int, QSharedPointer<Stringifier>> TypeStringifiersMap;
 
 ///
-/// \brief The LRectStringifier class is a stringifier for the QRectF and QRect types. It
-/// serializes QRectF to x,y,w,h by using the dot as the decimal separator.
+/// \brief The InstrumentationStats struct holds counters, in total and for each
+/// QMetaObject. Allocations are only counted in total.
 ///
-class RectStringifier : public Stringifier
+struct InstrumentationStats
 {
-public:
-    QString stringify(const QVariant& v) override {
-        if (v.isNull() || !v.canConvert<QRectF>())
-            return QString();
-        return lqt::string_from_rect(v.value<QRectF>());
-    }
+    Counters counters;
+    QHash<const QMetaObject*, Counters> perMetaObject;
 
-    QVariant destringify(const QString& s) override {
-        QRectF ret = lqt::string_to_rect(s);
-        return QVariant::fromValue(ret);
-    }
+    void clear();
+    InstrumentationStats& operator+=(const InstrumentationStats& other);
 };
 
 ///
-/// \brief The PointStringifier class is a stringifier for the QPointF and QPoint types. It
-/// serializes QPointF to x,y by using the dot as the decimal separator.
+/// \brief AllocationCounter is a function returning the number of heap allocations
+/// performed so far by the process, typically provided by a malloc hook.
 ///
-class PointStringifier : public Stringifier
+typedef quint64 (*AllocationCounter)();
+void setAllocationCounter(AllocationCounter counter);
+AllocationCounter allocationCounter();
+
+///
+/// \brief The Instrumentation class collects the counters of the last call and
+/// the cumulative counters of all the calls.
+///
+class Instrumentation
 {
 public:
-    QString stringify(const QVariant& v) override {
-        if (v.isNull() || !v.canConvert<QPointF>())
-            return QString();
-        return lqt::string_from_point(v.value<QPointF>());
-    }
+    const InstrumentationStats& lastCall() const { return m_lastCall; }
+    const InstrumentationStats& total() const { return m_total; }
+    void reset();
 
-    QVariant destringify(const QString& s) override {
-        QPointF p = lqt::string_to_point(s);
-        return QVariant::fromValue(p);
-    }
+    void count(const QMetaObject* metaObject, quint64 Counters::* counter);
+
+private:
+    friend class InstrumentationCall;
+    InstrumentationStats m_lastCall;
+    InstrumentationStats m_total;
+    quint64 m_allocationsAtStart = 0;
+    int m_depth = 0;
 };
 
 ///
-/// \brief The DateTimeStringifier class is a stringifier for the QDateTime type. It
-/// stringifies to ISO 8601, which is recommended and widely used in JSON.
+/// \brief The InstrumentationCall class marks the scope of a public call. Nested
+/// calls are accounted to the outermost one.
 ///
-class DateTimeStringifier : public Stringifier
+class InstrumentationCall
 {
 public:
-    QString stringify(const QVariant& v) override {
-        if (v.isNull() || !v.canConvert<QDateTime>())
-            return QString();
-        return v.value<QDateTime>().toString(Qt::ISODateWithMs);
-    }
+    InstrumentationCall(Instrumentation& instrumentation);
+    ~InstrumentationCall();
 
-    QVariant destringify(const QString& s) override {
-        return QDateTime::fromString(s, Qt::ISODateWithMs);
-    }
+private:
+    Instrumentation& m_instrumentation;
 };
 
 ///
-/// \brief The Serializer class can be used to serialize a QObject or a gadget.
+/// \brief The TypeStats struct holds the cumulative statistics of a type. Time is
+/// the time spent on objects of that type, excluding the time spent on children.
 ///
-class Serializer
+struct TypeStats
 {
-public:
-    Serializer(const MemberStringifiersMap& memberStringifiers = MemberStringifiersMap(),
-               const TypeStringifiersMap& typeStringifiers = TypeStringifiersMap());
-    template<class T> QJsonObject serialize(T* object);
-    template<class T> QJsonArray serialize(const QList<T>& array, const QMetaObject* metaObject = nullptr);
+    qint64 nsecs = 0;
+    quint64 objects = 0;
+    quint64 bytesIn = 0;
+    quint64 bytesOut = 0;
+    quint64 warnings = 0;
+
+    TypeStats& operator+=(const TypeStats& other);
+    QVariantMap toVariantMap() const;
+};
 
+///
+/// \brief The StatsCollector class collects the statistics of each type serialized
+/// or deserialized by the Serializer and Deserializer instances it is set on. The
+/// same collector can be shared by instances living in different threads: each thread
+/// accumulates locally and data is merged when read.
+///
+class StatsCollector
+{
 public:
-    QJsonValue serializeObject(const void* value, const QMetaObject* metaObj);
-    QJsonArray serializeArray(const LSequentialIterable& it, const QMetaObject* metaObject);
-    template<typename T>
-    QJsonValue serializeDictionary(const T& variant);
-    QJsonValue serializeValue(const char* propName, const QVariant& value, const QMetaObject* metaObject);
+    void record(const QMetaObject* metaObject, const TypeStats& stats);
+    void recordBytesIn(const QMetaObject* metaObject, quint64 bytes);
+    void recordBytesOut(const QMetaObject* metaObject, quint64 bytes);
+    void recordWarning(const QMetaObject* metaObject);
+
+    QHash<const QMetaObject*, TypeStats> snapshot() const;
+    QVariantMap toVariantMap() const;
+    QJsonObject toJson() const;
+    void reset();
 
 private:
-    MemberStringifiersMap m_memberStringifiers;
-    TypeStringifiersMap m_typeStringifiers;
+    struct Shard
+    {
+        QMutex mutex;
+        QHash<const QMetaObject*, TypeStats> stats;
+    };
+    Shard* localShard();
+
+private:
+    mutable QMutex m_mutex;
+    QList<QSharedPointer<Shard>> m_shards;
+    QThreadStorage<QSharedPointer<Shard>> m_localShard;
 };
 
-template<typename T>
-QJsonValue Serializer::serializeDictionary(const T& variant)
+///
+/// \brief The StatsScope class measures the time spent on a single object. Time
+/// spent on nested scopes is subtracted.
+///
+class StatsScope
 {
-    QJsonObject ret;
-    for (auto it = variant.constBegin(), end = variant.constEnd(); it != end; it++) {
-        const QJsonValue v = serializeValue(it.key().toLocal8Bit(), *it, nullptr);
-        if (v.isNull())
-            continue;
-        ret[it.key()] = v;
-    }
+public:
+    StatsScope(StatsCollector* collector, const QMetaObject* metaObject, StatsScope** current);
+    ~StatsScope();
 
-    return ret;
-}
+private:
+    StatsCollector* m_collector;
+    const QMetaObject* m_metaObject;
+    StatsScope** m_current;
+    StatsScope* m_parent;
+    qint64 m_childNsecs;
+    QElapsedTimer m_timer;
+};
 
-template<class T>
-QJsonObject Serializer::serialize(T* object)
+///
+/// \brief The Error struct describes a problem found while deserializing. The path
+/// locates the value in the document, e.g. menu.items[3].label.
+///
+struct Error
 {
-    return !object ? QJsonObject() : serializeObject(object, &T::staticMetaObject).toObject();
-}
+    enum Code {
+        ParseError,
+        UnknownType,
+        UnsupportedType,
+        MissingAdder,
+        AdderFailed,
+        ReadOnlyProperty,
+        WriteFailed,
+        UnknownKey,
+        TypeMismatch,
+        MissingRequired,
+        LimitExceeded
+    };
+
+    Code code;
+    QString path;
+    QString property;
+
+    QString toString() const;
+};
 
-template<class T>
-QJsonArray Serializer::serialize(const QList<T>& array, const QMetaObject* metaObject)
+///
+/// \brief The Limits struct bounds the work done on a document. Negative values mean no
+/// limit. Exceeding a limit aborts the deserialization with Error::LimitExceeded,
+/// whose property is the name of the limit. Objects and arrays both count toward the
+/// depth, the root included. String bytes are the UTF-8 bytes of all keys and string
+/// values, once escapes are decoded.
+///
+struct Limits
 {
-    QVariant list = QVariant::fromValue(array);
-    return serializeArray(list.value<LSequentialIterable>(), metaObject);
-}
+    int maxDepth = -1;
+    qint64 maxArrayLength = -1;
+    qint64 maxObjects = -1;
+    qint64 maxStringBytes = -1;
+    qint64 maxInputBytes = -1;
+};
 
 ///
-/// \brief The Serializer class can be used to deserialize a JSON to a QObject or a gadget.
+/// \brief The LimitScanner class checks a JSON text against Limits without parsing it.
+/// The text can be fed in chunks; counts are exact only for valid JSON.
 ///
-template<class T>
-class Deserializer
+class LimitScanner
 {
 public:
-    Deserializer(const MemberStringifiersMap& stringifiers = MemberStringifiersMap(),
-                 const TypeStringifiersMap& typeStringifiers = TypeStringifiersMap());
-    T* deserialize(const QJsonObject& json);
-    T* deserialize(const QString& jsonString);
-    QList<QString> deserializeStringArray(const QJsonArray& array);
-    QList<double>  deserializeNumberArray(const QJsonArray& array);
-    QList<bool>    deserializeBoolArray(const QJsonArray& array);
-    QList<T*>      deserializeObjectArray(const QJsonArray &array);
+    explicit LimitScanner(const Limits& limits = Limits()) { reset(limits); }
 
-    static void lserializerRegisterObject(const QMetaObject& metaObject);
+    const char* feed(const char* data, qsizetype size);
+    void reset(const Limits& limits);
 
-protected:
-    void deserializeJson(QJsonObject json,
-                         void* dest,
-                         const QMetaObject* metaObject);
-    void deserializeValue(const QJsonValue& value,
-                          const QMetaProperty& metaProp,
-                          void* dest,
-                          bool isGadget,
-                          const QMetaObject* metaObject);
-    void deserializeArray(const QJsonArray& array,
-                          const QMetaProperty& metaProp,
-                          void* dest);
-    void deserializeObjectArray(const QJsonArray& array,
-                                const QString& propName,
-                                const QString& type,
-                                QObject* dest);
-    void* instantiateObject(const QJsonValue& value,
-                            const QMetaType& metaType,
-                            bool isGadget,
-                            QObject* parent);
-    QVariant destringify(const QString& value,
-                         const QMetaProperty& metaProp,
-                         const QMetaObject* metaObject);
+private:
+    Limits m_limits;
+    bool m_enabled;
+    // Elements seen in each open array; -1 for objects.
+    QVector<qint64> m_elements;
+    // Set after '[' until the first element or ']' is seen.
+    bool m_arrayStart;
+    qint64 m_objects;
+    qint64 m_stringBytes;
+    bool m_inString;
+    bool m_escape;
+    int m_hexDigits;
+    uint m_codePoint;
+};
 
-protected:
-    void writeProp(const QMetaProperty& metaProp, void* dest, const QVariant& value, bool isGadget);
-    int metatype_from_name(const QString& typeName) {
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-        return QMetaType::fromName(typeName.toLatin1()).id();
-#else
-        return QMetaType::type(typeName.toLatin1().data());
-#endif
+const char* check_json_limits(const char* data, qsizetype size, const Limits& limits);
+const char* check_json_limits(const QJsonValue& value, const Limits& limits);
+
+void register_polymorphic_type(const QMetaObject* base, const QString& key, const QString& value, const QMetaObject* type);
+bool polymorphic_subtypes(const QMetaObject* base, QString* key, QHash<QString, const QMetaObject*>* subtypes);
+bool polymorphic_discriminator(const QMetaObject* type, QString* key, QString* value);
+
+///
+/// \brief registerPolymorphic registers Derived as a concrete type of the properties and
+/// arrays of Base*: JSON objects where the member key equals value are instantiated as
+/// Derived, objects without the member as Base. Serialized Derived objects include
+/// the member.
+///
+template<class Base, class Derived>
+void registerPolymorphic(const QString& key, const QString& value)
+{
+    static_assert(std::is_base_of<QObject, Base>::value, "Polymorphic types must be QObject's");
+    static_assert(std::is_base_of<Base, Derived>::value, "Derived must inherit Base");
+    register_polymorphic_type(&Base::staticMetaObject, key, value, &Derived::staticMetaObject);
+}
+
+///
+/// \brief The PathElement struct is an element of the path of the value being
+/// deserialized: either a key or an array index.
+///
+struct PathElement
+{
+    const QString* key;
+    int index;
+};
+typedef QVector<PathElement> Path;
+QString path_to_string(const Path& path);
+
+///
+/// \brief The PathGuard class pushes an element to the path for the duration of
+/// its scope.
+///
+class PathGuard
+{
+public:
+    PathGuard(Path& path, const QString* key) : m_path(path) {
+        PathElement element = { key, -1 };
+        m_path.append(element);
+    }
+    PathGuard(Path& path, int index) : m_path(path) {
+        PathElement element = { nullptr, index };
+        m_path.append(element);
     }
+    ~PathGuard() { m_path.removeLast(); }
 
 private:
-    QRegularExpression m_arrayTypeRegex;
-    MemberStringifiersMap m_memberStringifiers;
-    TypeStringifiersMap m_typeStringifiers;
+    Path& m_path;
 };
 
-inline Stringifier* find_stringifier(const QMetaObject* metaObject,
-                                     const char* propName,
-                                     const QMetaType& metaType,
-                                     const MemberStringifiersMap& memberStringifiers,
-                                     const TypeStringifiersMap& typeStringifiers)
+///
+/// \brief The LogRateLimiter class limits the number of messages logged per second.
+///
+class LogRateLimiter
 {
-    if (!metaObject)
-        return nullptr;
+public:
+    LogRateLimiter() : m_enabled(false), m_maxPerSecond(10), m_count(0) {}
+    void setEnabled(bool enabled, int maxPerSecond);
+    bool isEnabled() const { return m_enabled; }
+    bool acquire();
 
-    const int classInfoIndex = metaObject->indexOfClassInfo(propName);
-    if (classInfoIndex >= 0) {
-        const QString stringifierName = QString(metaObject->classInfo(classInfoIndex).value());
-        if (memberStringifiers.contains(stringifierName))
-            return memberStringifiers.value(stringifierName).data();
-    }
+private:
+    bool m_enabled;
+    int m_maxPerSecond;
+    int m_count;
+    QElapsedTimer m_window;
+};
 
-    if (typeStringifiers.contains(metaType.id()))
-        return typeStringifiers.value(metaType.id()).data();
+///
+/// \brief The RawJson class holds a JSON value that is not deserialized, e.g. an opaque
+/// blob that is only forwarded. It stores either the raw bytes of the value or the
+/// QJsonValue shared with the parsed document, and parses or converts only when
+/// asked.
+///
+class RawJson
+{
+public:
+    RawJson() {}
+    explicit RawJson(const QJsonValue& value) : m_value(value), m_hasValue(true) {}
+    static RawJson fromJson(const QByteArray& json);
 
-    return nullptr;
-}
+    bool isNull() const { return !m_hasValue && m_json.isEmpty(); }
+    QJsonValue value() const;
+    QByteArray toJson() const;
+    qint64 heapSize() const;
 
-template<class T>
-QVariant deserialize_array(const QJsonArray& array, std::function<T(const QJsonValue& jsonValue)> convert)
-{
-    QJsonArray::const_iterator it = array.constBegin();
-    QList<T> list;
-    while (it != array.constEnd()) {
-        list.append(convert(*it));
-        ++it;
-    }
+    bool operator==(const RawJson& other) const;
+    bool operator!=(const RawJson& other) const { return !(*this == other); }
 
-    return QVariant::fromValue(list);
-}
+private:
+    QJsonValue m_value;
+    bool m_hasValue = false;
+    QByteArray m_json;
+};
 
-template<class T>
-Deserializer<T>::Deserializer(const MemberStringifiersMap& memberStringifiers, const TypeStringifiersMap& typeStringifiers) :
-    m_arrayTypeRegex(QStringLiteral("^(QList)<([^\\*]+(\\*){0,1})>$"))
-  , m_memberStringifiers(memberStringifiers)
-  , m_typeStringifiers(typeStringifiers) {}
+} // namespace lqo
 
-template<class T>
-T* Deserializer<T>::deserialize(const QJsonObject& json)
+Q_DECLARE_METATYPE(lqo::RawJson)
+
+namespace lqo {
+
+///
+/// \brief The GadgetArrayKernel struct builds and walks a container of gadgets stored
+/// by value, like QList<Gadget> or std::vector<Gadget>. Elements are constructed in
+/// place in the container, so they need no allocation or deletion of their own.
+///
+struct GadgetArrayKernel
 {
-    T* t = new T;
-    deserializeJson(json, t, &T::staticMetaObject);
-    return t;
-}
+    typedef std::function<void(int index, void* element, const QJsonValue& value)> Filler;
+    typedef std::function<void(const void* element)> Visitor;
 
-template<class T>
-T* Deserializer<T>::deserialize(const QString& jsonString)
+    const QMetaObject* metaObject;
+    QVariant (*build)(const QJsonArray& array, const Filler& fill);
+    void (*visit)(const QVariant& container, const Visitor& visit);
+};
+
+void register_gadget_array_kernel(int metaTypeId, const GadgetArrayKernel& kernel);
+bool gadget_array_kernel(int metaTypeId, GadgetArrayKernel* kernel);
+
+template<class G, class Container>
+QVariant build_gadget_array(const QJsonArray& array, const GadgetArrayKernel::Filler& fill)
 {
-    QJsonDocument doc = QJsonDocument::fromJson(jsonString.toUtf8());
-    QJsonObject json = doc.object();
-    return deserialize(json);
+    // Build the container directly inside the variant to avoid copying it.
+    QVariant ret = QVariant::fromValue(Container());
+    Container* container = reinterpret_cast<Container*>(ret.data());
+    container->reserve(array.size());
+    int index = 0;
+    for (const QJsonValue& value : array) {
+        container->push_back(G());
+        fill(index++, &container->back(), value);
+    }
+
+    return ret;
 }
 
-template<class T>
-QList<QString> Deserializer<T>::deserializeStringArray(const QJsonArray& array)
+template<class G, class Container>
+void visit_gadget_array(const QVariant& value, const GadgetArrayKernel::Visitor& visit)
 {
-    return deserialize_array<QString>(array, [] (const QJsonValue& jsonValue) -> QString {
-        return jsonValue.toString();
-    }).toStringList();
+    const Container& container = *reinterpret_cast<const Container*>(value.constData());
+    for (const G& element : container)
+        visit(&element);
 }
 
-template<class T>
-QList<double> Deserializer<T>::deserializeNumberArray(const QJsonArray& array)
+///
+/// \brief registerGadgetArray enables QList<G> and std::vector<G> properties, where G
+/// is a gadget.
+///
+template<class G>
+void registerGadgetArray()
 {
-    QVariant v = deserialize_array<double>(array, [] (const QJsonValue& jsonValue) -> double {
-        return jsonValue.toDouble();
-    });
-    return v.value<QList<double>>();
+    GadgetArrayKernel kernel;
+    kernel.metaObject = &G::staticMetaObject;
+    kernel.build = &build_gadget_array<G, QList<G> >;
+    kernel.visit = &visit_gadget_array<G, QList<G> >;
+    register_gadget_array_kernel(qRegisterMetaType<QList<G> >(), kernel);
+
+    kernel.build = &build_gadget_array<G, std::vector<G> >;
+    kernel.visit = &visit_gadget_array<G, std::vector<G> >;
+    register_gadget_array_kernel(qRegisterMetaType<std::vector<G> >(), kernel);
 }
 
-template<class T>
-QList<bool> Deserializer<T>::deserializeBoolArray(const QJsonArray &array)
+///
+/// \brief The DictionaryKernel struct builds and walks a QHash<QString, V> or a
+/// QMap<QString, V> directly, without converting it to a QVariantHash or QVariantMap.
+/// V can be a basic type, a pointer to a QObject or a gadget. Dictionaries of basic
+/// types and of QObject* are always available, others must be registered with
+/// registerObjectDictionary() or registerGadgetDictionary().
+///
+struct DictionaryKernel
 {
-    QVariant v = deserialize_array<bool>(array, [] (const QJsonValue& jsonValue) -> bool {
-        return jsonValue.toBool();
-    });
-    return v.value<QList<bool>>();
-}
+    enum Kind {
+        Value,
+        ObjectPointer,
+        Gadget
+    };
+
+    typedef std::function<void(const QString& key, void* element, const QJsonValue& value)> Filler;
+    typedef std::function<QJsonValue(const void* element)> Writer;
+    typedef std::function<void(const QString& key, const void* element)> Visitor;
+
+    Kind kind;
+    int valueType;
+    QVariant (*build)(const QJsonObject& object, const Filler& fill);
+    QJsonObject (*write)(const QVariant& dictionary, const Writer& write);
+    void (*visit)(const QVariant& dictionary, const Visitor& visit);
+};
+
+void register_dictionary_kernel(int metaTypeId, const DictionaryKernel& kernel);
+bool dictionary_kernel(int metaTypeId, DictionaryKernel* kernel);
+
+template<class V> V json_to(const QJsonValue& value);
+
+///
+/// \brief json_to<qlonglong> keeps all the 64 bits of integers on Qt 6. Qt 5 stores JSON
+/// numbers as double, so integers beyond ±2^53 are already rounded when parsed.
+///
+template<> inline qlonglong json_to<qlonglong>(const QJsonValue& value)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    return value.toInteger(qlonglong(value.toDouble()));
+#else
+    return qlonglong(value.toDouble());
+#endif
+}
+
+template<> inline int json_to<int>(const QJsonValue& value) { return value.toInt(); }
+template<> inline float json_to<float>(const QJsonValue& value) { return float(value.toDouble()); }
+template<> inline double json_to<double>(const QJsonValue& value) { return value.toDouble(); }
+template<> inline bool json_to<bool>(const QJsonValue& value) { return value.toBool(); }
+template<> inline QString json_to<QString>(const QJsonValue& value) { return value.toString(); }
+
+template<class V>
+void reserve_dictionary(QHash<QString, V>* dictionary, int size) { dictionary->reserve(size); }
+template<class V>
+void reserve_dictionary(QMap<QString, V>*, int) {}
+
+template<class Container, class V>
+QVariant build_value_dictionary(const QJsonObject& object, const DictionaryKernel::Filler&)
+{
+    QVariant ret = QVariant::fromValue(Container());
+    Container* dictionary = reinterpret_cast<Container*>(ret.data());
+    reserve_dictionary(dictionary, object.size());
+    for (QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it)
+        dictionary->insert(it.key(), json_to<V>(it.value()));
+    return ret;
+}
+
+template<class Container, class V>
+QJsonObject write_value_dictionary(const QVariant& value, const DictionaryKernel::Writer&)
+{
+    const Container& dictionary = *reinterpret_cast<const Container*>(value.constData());
+    QJsonObject ret;
+    for (typename Container::const_iterator it = dictionary.constBegin(); it != dictionary.constEnd(); ++it)
+        ret.insert(it.key(), QJsonValue(it.value()));
+    return ret;
+}
+
+template<class Container>
+QVariant build_dictionary(const QJsonObject& object, const DictionaryKernel::Filler& fill)
+{
+    QVariant ret = QVariant::fromValue(Container());
+    Container* dictionary = reinterpret_cast<Container*>(ret.data());
+    reserve_dictionary(dictionary, object.size());
+    for (QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it)
+        fill(it.key(), &(*dictionary)[it.key()], it.value());
+    return ret;
+}
+
+template<class Container>
+QJsonObject write_dictionary(const QVariant& value, const DictionaryKernel::Writer& write)
+{
+    const Container& dictionary = *reinterpret_cast<const Container*>(value.constData());
+    QJsonObject ret;
+    for (typename Container::const_iterator it = dictionary.constBegin(); it != dictionary.constEnd(); ++it) {
+        const QJsonValue v = write(&it.value());
+        if (!v.isNull())
+            ret.insert(it.key(), v);
+    }
+
+    return ret;
+}
+
+template<class Container>
+void visit_dictionary(const QVariant& value, const DictionaryKernel::Visitor& visit)
+{
+    const Container& dictionary = *reinterpret_cast<const Container*>(value.constData());
+    for (typename Container::const_iterator it = dictionary.constBegin(); it != dictionary.constEnd(); ++it)
+        visit(it.key(), &it.value());
+}
+
+template<class Container, class V>
+DictionaryKernel make_value_dictionary_kernel()
+{
+    DictionaryKernel kernel;
+    kernel.kind = DictionaryKernel::Value;
+    kernel.valueType = qMetaTypeId<V>();
+    kernel.build = &build_value_dictionary<Container, V>;
+    kernel.write = &write_value_dictionary<Container, V>;
+    kernel.visit = &visit_dictionary<Container>;
+    return kernel;
+}
+
+template<class Container, class V>
+DictionaryKernel make_dictionary_kernel(DictionaryKernel::Kind kind)
+{
+    DictionaryKernel kernel;
+    kernel.kind = kind;
+    kernel.valueType = qRegisterMetaType<V>();
+    kernel.build = &build_dictionary<Container>;
+    kernel.write = &write_dictionary<Container>;
+    kernel.visit = &visit_dictionary<Container>;
+    return kernel;
+}
+
+///
+/// \brief registerObjectDictionary enables QHash<QString, O*> and QMap<QString, O*>
+/// properties, where O is a QObject subclass.
+///
+template<class O>
+void registerObjectDictionary()
+{
+    register_dictionary_kernel(qRegisterMetaType<QHash<QString, O*> >(),
+                               make_dictionary_kernel<QHash<QString, O*>, O*>(DictionaryKernel::ObjectPointer));
+    register_dictionary_kernel(qRegisterMetaType<QMap<QString, O*> >(),
+                               make_dictionary_kernel<QMap<QString, O*>, O*>(DictionaryKernel::ObjectPointer));
+}
+
+///
+/// \brief registerGadgetDictionary enables QHash<QString, G> and QMap<QString, G>
+/// properties, where G is a gadget.
+///
+template<class G>
+void registerGadgetDictionary()
+{
+    register_dictionary_kernel(qRegisterMetaType<QHash<QString, G> >(),
+                               make_dictionary_kernel<QHash<QString, G>, G>(DictionaryKernel::Gadget));
+    register_dictionary_kernel(qRegisterMetaType<QMap<QString, G> >(),
+                               make_dictionary_kernel<QMap<QString, G>, G>(DictionaryKernel::Gadget));
+}
+
+///
+/// \brief The Hasher class computes a 64 bit hash of the data added to it, using the
+/// rounds of xxHash64 on 8 byte words. The result is not portable across platforms
+/// with different endianness.
+///
+class Hasher
+{
+public:
+    explicit Hasher(quint64 seed = 0);
+
+    void add(const void* data, qsizetype size);
+    void add(quint64 value) { add(&value, sizeof(value)); }
+    quint64 result() const;
+
+private:
+    void mix(quint64 word);
+
+private:
+    quint64 m_state;
+    quint64 m_length;
+    quint64 m_tail;
+    int m_tailSize;
+};
+
+quint64 hash_json(const QJsonValue& value);
+
+///
+/// \brief The SharedGadgetKernel struct enables QSharedPointer<G> properties, where G
+/// is a gadget. When deduplicate is set, identical JSON objects deserialized in the
+/// same call share a single instance: G must then be treated as immutable.
+///
+struct SharedGadgetKernel
+{
+    int gadgetPointerType;
+    bool deduplicate;
+    QVariant (*wrap)(void* gadget);
+    const void* (*get)(const QVariant& value);
+};
+
+void register_shared_gadget_kernel(int metaTypeId, const SharedGadgetKernel& kernel);
+bool shared_gadget_kernel(int metaTypeId, SharedGadgetKernel* kernel);
+
+template<class G>
+QVariant wrap_shared_gadget(void* gadget)
+{
+    return QVariant::fromValue(QSharedPointer<G>(static_cast<G*>(gadget)));
+}
+
+template<class G>
+const void* get_shared_gadget(const QVariant& value)
+{
+    return reinterpret_cast<const QSharedPointer<G>*>(value.constData())->data();
+}
+
+template<class G>
+void registerSharedGadget(bool deduplicate = false)
+{
+    SharedGadgetKernel kernel;
+    kernel.gadgetPointerType = qRegisterMetaType<G*>();
+    kernel.deduplicate = deduplicate;
+    kernel.wrap = &wrap_shared_gadget<G>;
+    kernel.get = &get_shared_gadget<G>;
+    register_shared_gadget_kernel(qRegisterMetaType<QSharedPointer<G> >(), kernel);
+}
+
+///
+/// \brief The MemoryUsage struct estimates the heap retained by the objects of a type:
+/// the objects themselves, including the private data of QObject's, and the strings,
+/// containers and other values held by their properties. Implicitly shared data is
+/// counted once per holder.
+///
+struct MemoryUsage
+{
+    qint64 instances = 0;
+    qint64 objectBytes = 0;
+    qint64 stringBytes = 0;
+    qint64 containerBytes = 0;
+    qint64 otherBytes = 0;
+
+    qint64 total() const { return objectBytes + stringBytes + containerBytes + otherBytes; }
+    MemoryUsage& operator+=(const MemoryUsage& other);
+    bool operator==(const MemoryUsage& other) const;
+    bool operator!=(const MemoryUsage& other) const { return !(*this == other); }
+};
+
+///
+/// \brief The MemoryReport struct breaks the memory retained by a tree down by
+/// QMetaObject. Values are attributed to the class declaring the property.
+///
+struct MemoryReport
+{
+    QHash<const QMetaObject*, MemoryUsage> types;
+
+    MemoryUsage total() const;
+    void clear() { types.clear(); }
+    MemoryReport& operator+=(const MemoryReport& other);
+    bool operator==(const MemoryReport& other) const { return types == other.types; }
+    bool operator!=(const MemoryReport& other) const { return !(*this == other); }
+};
+
+MemoryReport measure_memory(const void* object, const QMetaObject* metaObject);
+
+///
+/// \brief memoryUsage estimates the memory retained by object and by everything it
+/// references through its properties.
+///
+template<class T>
+MemoryReport memoryUsage(T* object)
+{
+    if (!object)
+        return MemoryReport();
+    return measure_memory(object, &T::staticMetaObject);
+}
+
+///
+/// \brief The NotificationMode enum controls the signals emitted while properties of
+/// QObject's are written. With CoalescedNotifications and NoNotifications signals are
+/// blocked and new objects are not parented until the whole tree is populated; then
+/// CoalescedNotifications emits the notify signal of each written property once. The
+/// handler set with setTreeReplacedHandler() is called after the tree is complete in
+/// every mode.
+///
+enum NotificationMode {
+    ImmediateNotifications,
+    CoalescedNotifications,
+    NoNotifications
+};
+
+struct SharedInstance
+{
+    QJsonValue json;
+    QVariant instance;
+};
+
+///
+/// \brief The Columns class stores an array of records column by column: one
+/// contiguous vector per property of the schema, with the strings of a column
+/// concatenated in one buffer. Integer, floating point, bool and QString properties
+/// are stored; other properties of the schema are ignored. Null rows keep their index
+/// and are tracked separately.
+///
+class Columns
+{
+public:
+    enum ColumnType {
+        IntColumn,
+        DoubleColumn,
+        BoolColumn,
+        StringColumn
+    };
+
+    struct Column
+    {
+        QString name;
+        ColumnType type;
+        QVector<qint64> ints;
+        QVector<double> doubles;
+        QVector<bool> bools;
+        QString strings;
+        QVector<int> offsets;
+    };
+
+    class Row
+    {
+    public:
+        Row(const Columns* columns, int row) : m_columns(columns), m_row(row) {}
+
+        qint64 toInt(int column) const { return m_columns->column(column).ints.at(m_row); }
+        double toDouble(int column) const { return m_columns->column(column).doubles.at(m_row); }
+        bool toBool(int column) const { return m_columns->column(column).bools.at(m_row); }
+        bool isNull() const { return m_columns->isNull(m_row); }
+        QStringView toString(int column) const { return m_columns->string(column, m_row); }
+        QVariant value(int column) const;
+        QVariant value(const QString& name) const { return value(m_columns->indexOf(name)); }
+
+    private:
+        const Columns* m_columns;
+        int m_row;
+    };
+
+    explicit Columns(const QMetaObject* schema = nullptr);
+
+    const QMetaObject* schema() const { return m_schema; }
+    int rowCount() const { return m_rowCount; }
+    int columnCount() const { return m_columns.size(); }
+    int indexOf(const QString& name) const;
+    const Column& column(int index) const { return m_columns.at(index); }
+    QStringView string(int column, int row) const;
+    Row row(int row) const { return Row(this, row); }
+    bool isNull(int row) const;
+    MemoryUsage memoryUsage() const;
+
+    void reserve(int rows);
+    void appendRow(const QJsonObject& object);
+    void appendNull();
+    void clear();
+
+    bool operator==(const Columns& other) const;
+    bool operator!=(const Columns& other) const { return !(*this == other); }
+
+private:
+    const QMetaObject* m_schema;
+    QVector<Column> m_columns;
+    QVector<int> m_nullRows;
+    int m_rowCount;
+};
+
+///
+/// \brief The Columnar class is a Columns property type whose schema is the class
+/// Item, e.g. Columnar<Item> in place of QList<Item*>. It must be registered with
+/// registerColumnar<Item>().
+///
+template<class Item>
+class Columnar : public Columns
+{
+public:
+    Columnar() : Columns(&Item::staticMetaObject) {}
+};
+
+struct ColumnarKernel
+{
+    const QMetaObject* metaObject;
+    QVariant (*create)(Columns** columns);
+    const Columns* (*columns)(const QVariant& value);
+};
+
+void register_columnar_kernel(int metaTypeId, const ColumnarKernel& kernel);
+bool columnar_kernel(int metaTypeId, ColumnarKernel* kernel);
+
+template<class Item>
+QVariant create_columnar(Columns** columns)
+{
+    QVariant ret = QVariant::fromValue(Columnar<Item>());
+    *columns = reinterpret_cast<Columnar<Item>*>(ret.data());
+    return ret;
+}
+
+template<class Item>
+const Columns* columnar_columns(const QVariant& value)
+{
+    return reinterpret_cast<const Columnar<Item>*>(value.constData());
+}
+
+template<class Item>
+void registerColumnar()
+{
+    ColumnarKernel kernel;
+    kernel.metaObject = &Item::staticMetaObject;
+    kernel.create = &create_columnar<Item>;
+    kernel.columns = &columnar_columns<Item>;
+    register_columnar_kernel(qRegisterMetaType<Columnar<Item> >(), kernel);
+}
+
+///
+/// \brief The PropertyKernel struct holds the kernel registered for a type, if any, so
+/// it can be looked up once per property instead of once per value.
+///
+struct PropertyKernel
+{
+    enum Kind {
+        None,
+        SharedGadget,
+        Dictionary,
+        GadgetArray,
+        Columnar
+    };
+
+    Kind kind = None;
+    SharedGadgetKernel sharedGadget;
+    DictionaryKernel dictionary;
+    GadgetArrayKernel gadgetArray;
+    ColumnarKernel columnar;
+};
+PropertyKernel property_kernel(int metaTypeId);
+
+///
+/// \brief The ObjectPlan struct caches what is needed to map the members of a JSON
+/// object to the properties of a QMetaObject. Required properties are listed in the
+/// "lqo.required" class info, separated by commas. For polymorphic types, subtypes
+/// maps the values of the discriminator member to the concrete types, and typeKey is
+/// the discriminator emitted by the type itself. kernels holds the kernel of each
+/// property, by index. Plans are made again when registry_generation() changes, i.e.
+/// after a kernel or a polymorphic type is registered.
+///
+struct ObjectPlan
+{
+    QHash<QString, int> properties;
+    QVector<PropertyKernel> kernels;
+    QStringList required;
+    QString discriminator;
+    QHash<QString, const QMetaObject*> subtypes;
+    QString typeKey;
+};
+ObjectPlan make_object_plan(const QMetaObject* metaObject);
+int registry_generation();
+
+///
+/// \brief The JsonScanner class splits a JSON document, fed in chunks, into the
+/// members of the root object or into the elements of the root array, as soon as
+/// each of them is complete. Values are not parsed: their raw bytes are returned.
+///
+class JsonScanner
+{
+public:
+    enum Status {
+        NeedMoreData,
+        Value,
+        Finished,
+        Error
+    };
+
+    JsonScanner();
+    void feed(const char* data, qsizetype size);
+    Status next();
+    void reset();
+
+    bool isRootArray() const { return m_rootIsArray; }
+    QByteArray key() const { return m_key; }
+    QByteArray value() const { return m_value; }
+    QString errorString() const { return m_errorString; }
+
+private:
+    enum State {
+        BeforeRoot,
+        BeforeKey,
+        InKey,
+        AfterKey,
+        BeforeValue,
+        InValue,
+        AfterValue,
+        Done,
+        Failed
+    };
+
+    Status completeValue();
+    Status fail(const QString& errorString);
+
+private:
+    QByteArray m_buffer;
+    qsizetype m_pos;
+    qsizetype m_tokenStart;
+    State m_state;
+    bool m_rootIsArray;
+    bool m_first;
+    int m_depth;
+    bool m_inString;
+    bool m_escape;
+    QByteArray m_key;
+    QByteArray m_value;
+    QString m_errorString;
+};
+
+///
+/// \brief The JsonReader class reads a complete JSON text value by value, without
+/// building a document. Containers are entered with beginObject() and beginArray()
+/// and iterated with nextMember() and nextElement(); any value can be skipped. Once
+/// malformed JSON is found, every call fails and hasError() returns true.
+///
+class JsonReader
+{
+public:
+    enum Type {
+        Invalid,
+        Null,
+        Bool,
+        Number,
+        String,
+        Object,
+        Array
+    };
+
+    JsonReader(const char* data, qsizetype size);
+
+    Type peek();
+    QJsonValue readScalar();
+    bool readString(QByteArray* utf8);
+    bool beginObject();
+    bool nextMember(QByteArray* key);
+    bool beginArray();
+    bool nextElement();
+    bool skipValue();
+    QJsonValue peekMember(const QByteArray& key) const;
+    bool atEnd();
+    bool hasError() const { return m_error; }
+
+private:
+    void skipSpace();
+    bool fail();
+    bool readLiteral(const char* literal, int size);
+    bool readNumber(double* value);
+    bool readHex(uint* value);
+    bool beginContainer(char c);
+    bool endContainer(char c);
+
+private:
+    const char* m_data;
+    qsizetype m_size;
+    qsizetype m_pos;
+    int m_depth;
+    // Whether the current container has no values yet, so no comma is expected.
+    bool m_first;
+    bool m_error;
+};
+
+///
+/// \brief The LStringifier class is an interface for objects used to automatically
+/// stringify or destringify objects when serializing/deserializing.
+///
+class Stringifier
+{
+public:
+    virtual ~Stringifier() {}
+    virtual QString stringify(const QVariant&) { return QString(); }
+    virtual QVariant destringify(const QString&) { return QVariant(); }
+};
+typedef QHash<QString, QSharedPointer<Stringifier>> MemberStringifiersMap;
+typedef QHash<int, QSharedPointer<Stringifier>> TypeStringifiersMap;
+
+///
+/// \brief The LRectStringifier class is a stringifier for the QRectF and QRect types. It
+/// serializes QRectF to x,y,w,h by using the dot as the decimal separator.
+///
+class RectStringifier : public Stringifier
+{
+public:
+    QString stringify(const QVariant& v) override {
+        if (v.isNull() || !v.canConvert<QRectF>())
+            return QString();
+        return lqt::string_from_rect(v.value<QRectF>());
+    }
+
+    QVariant destringify(const QString& s) override {
+        QRectF ret = lqt::string_to_rect(s);
+        return QVariant::fromValue(ret);
+    }
+};
+
+///
+/// \brief The PointStringifier class is a stringifier for the QPointF and QPoint types. It
+/// serializes QPointF to x,y by using the dot as the decimal separator.
+///
+class PointStringifier : public Stringifier
+{
+public:
+    QString stringify(const QVariant& v) override {
+        if (v.isNull() || !v.canConvert<QPointF>())
+            return QString();
+        return lqt::string_from_point(v.value<QPointF>());
+    }
+
+    QVariant destringify(const QString& s) override {
+        QPointF p = lqt::string_to_point(s);
+        return QVariant::fromValue(p);
+    }
+};
+
+///
+/// \brief The DateTimeStringifier class is a stringifier for the QDateTime type. It
+/// stringifies to ISO 8601, which is recommended and widely used in JSON.
+///
+class DateTimeStringifier : public Stringifier
+{
+public:
+    QString stringify(const QVariant& v) override {
+        if (v.isNull() || !v.canConvert<QDateTime>())
+            return QString();
+        return v.value<QDateTime>().toString(Qt::ISODateWithMs);
+    }
+
+    QVariant destringify(const QString& s) override {
+        return QDateTime::fromString(s, Qt::ISODateWithMs);
+    }
+};
+
+///
+/// \brief The JsonWriter class writes compact JSON to a buffer. Separators are added
+/// automatically; raw values are copied verbatim and valid UTF-8 strings are only
+/// escaped.
+///
+class JsonWriter
+{
+public:
+    explicit JsonWriter(QByteArray* buffer) : m_buffer(buffer), m_afterKey(false) {}
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void writeKey(const char* key);
+    void writeKey(const QString& key);
+    void writeValue(const QJsonValue& value);
+    void writeUtf8(const QByteArray& utf8);
+    void writeRaw(const QByteArray& json);
+
+    QByteArray* buffer() const { return m_buffer; }
+    int depth() const { return m_hasElements.size(); }
+
+private:
+    void prefix();
+    void writeString(const QByteArray& utf8);
+
+private:
+    QByteArray* m_buffer;
+    QVector<bool> m_hasElements;
+    bool m_afterKey;
+};
+
+///
+/// \brief The Serializer class can be used to serialize a QObject or a gadget.
+///
+class Serializer
+{
+public:
+    Serializer(const MemberStringifiersMap& memberStringifiers = MemberStringifiersMap(),
+               const TypeStringifiersMap& typeStringifiers = TypeStringifiersMap());
+    template<class T> QJsonObject serialize(T* object);
+    template<class T> QJsonArray serialize(const QList<T>& array, const QMetaObject* metaObject = nullptr);
+    template<class T> QByteArray serializeToJson(T* object);
+    template<class T> quint64 hash(T* object);
+
+public:
+    QJsonValue serializeObject(const void* value, const QMetaObject* metaObj);
+    QJsonArray serializeArray(const LSequentialIterable& it, const QMetaObject* metaObject);
+    template<typename T>
+    QJsonValue serializeDictionary(const T& variant);
+    QJsonValue serializeValue(const char* propName, const QVariant& value, const QMetaObject* metaObject);
+
+    const Instrumentation& instrumentation() const { return m_instrumentation; }
+    void setStatsCollector(const QSharedPointer<StatsCollector>& collector) { m_statsCollector = collector; }
+    QSharedPointer<StatsCollector> statsCollector() const { return m_statsCollector; }
+    void setValidateRawJson(bool validate) { m_validateRawJson = validate; }
+
+    void writeObject(JsonWriter& writer, const void* object, const QMetaObject* metaObj);
+    void writeValue(JsonWriter& writer, const char* propName, const QVariant& value, const QMetaObject* metaObject);
+    void hashObject(Hasher& hasher, const void* object, const QMetaObject* metaObj);
+    void hashValue(Hasher& hasher, const char* propName, const QVariant& value, const QMetaObject* metaObject);
+
+private:
+    MemberStringifiersMap m_memberStringifiers;
+    TypeStringifiersMap m_typeStringifiers;
+    Instrumentation m_instrumentation;
+    QSharedPointer<StatsCollector> m_statsCollector;
+    StatsScope* m_statsScope = nullptr;
+    bool m_validateRawJson = false;
+};
+
+template<typename T>
+QJsonValue Serializer::serializeDictionary(const T& variant)
+{
+    QJsonObject ret;
+    for (auto it = variant.constBegin(), end = variant.constEnd(); it != end; it++) {
+        L_INSTR_COUNT(m_instrumentation, nullptr, variantConstructions);
+        // Without a metaObject the name is not used to find a stringifier.
+        const QJsonValue v = serializeValue(nullptr, *it, nullptr);
+        if (v.isNull())
+            continue;
+        ret[it.key()] = v;
+    }
+
+    return ret;
+}
+
+template<class T>
+QJsonObject Serializer::serialize(T* object)
+{
+    L_INSTR_CALL(m_instrumentation);
+    return !object ? QJsonObject() : serializeObject(object, &T::staticMetaObject).toObject();
+}
+
+///
+/// \brief Serializer::serializeToJson serializes directly to compact UTF-8 JSON. RawJson
+/// values are copied verbatim into the output, so documents can be assembled from
+/// fragments that are already serialized. Enable setValidateRawJson() to check those
+/// fragments: invalid ones are written as null.
+///
+template<class T>
+QByteArray Serializer::serializeToJson(T* object)
+{
+    L_INSTR_CALL(m_instrumentation);
+    QByteArray ret;
+    if (!object)
+        return ret;
+
+    JsonWriter writer(&ret);
+    writeObject(writer, object, &T::staticMetaObject);
+    if (m_statsCollector)
+        m_statsCollector->recordBytesOut(&T::staticMetaObject, ret.size());
+    return ret;
+}
+
+///
+/// \brief Serializer::hash computes a 64 bit hash of the content of object, without
+/// producing JSON. Equal trees have equal hashes across runs of the same build; use it
+/// to detect changes, not as a cryptographic digest.
+///
+template<class T>
+quint64 Serializer::hash(T* object)
+{
+    L_INSTR_CALL(m_instrumentation);
+    Hasher hasher;
+    if (object)
+        hashObject(hasher, object, &T::staticMetaObject);
+    return hasher.result();
+}
+
+template<class T>
+QJsonArray Serializer::serialize(const QList<T>& array, const QMetaObject* metaObject)
+{
+    L_INSTR_CALL(m_instrumentation);
+    QVariant list = QVariant::fromValue(array);
+    return serializeArray(list.value<LSequentialIterable>(), metaObject);
+}
+
+///
+/// \brief The Codec class transforms a byte stream chunk by chunk. process() and finish()
+/// append their output to out; finish() completes the stream. On failure, both return
+/// false and errorString() describes the error.
+///
+class Codec
+{
+public:
+    virtual ~Codec() {}
+
+    virtual bool process(const char* data, qsizetype size, QByteArray* out) = 0;
+    virtual bool finish(QByteArray* out) = 0;
+    virtual void reset() = 0;
+    virtual QString errorString() const = 0;
+};
+
+///
+/// \brief The DeflateCodec class compresses or decompresses with zlib. It is only
+/// functional when the library is built with LQO_ZLIB; see isAvailable().
+///
+class DeflateCodec : public Codec
+{
+public:
+    enum Direction {
+        Compress,
+        Decompress
+    };
+
+    enum Format {
+        Zlib,
+        Gzip,
+        Raw
+    };
+
+    explicit DeflateCodec(Direction direction, Format format = Zlib, int level = -1);
+    ~DeflateCodec() override;
+
+    static bool isAvailable();
+
+    bool process(const char* data, qsizetype size, QByteArray* out) override;
+    bool finish(QByteArray* out) override;
+    void reset() override;
+    QString errorString() const override;
+
+private:
+    Q_DISABLE_COPY(DeflateCodec)
+    bool run(const char* data, qsizetype size, QByteArray* out, bool last);
+
+private:
+    struct Private;
+    QScopedPointer<Private> d;
+};
+
+///
+/// \brief The StreamSerializer class writes a sequence of objects to a QIODevice, either
+/// as a single JSON array or as newline delimited JSON. Output is accumulated in a
+/// buffer that is flushed every chunkSize bytes; before writing, the serializer waits
+/// until the bytes pending in the device drop below maxPendingBytes. Peak memory is
+/// bounded by the chunk size and by the largest single object.
+///
+/// Waiting relies on QIODevice::waitForBytesWritten(), so with sockets or processes
+/// the serializer blocks the calling thread. When a codec is set, each chunk is
+/// encoded before it reaches the device.
+///
+class StreamSerializer
+{
+public:
+    enum Mode {
+        JsonArray,
+        JsonLines
+    };
+
+    explicit StreamSerializer(QIODevice* device,
+                              Mode mode = JsonArray,
+                              const MemberStringifiersMap& memberStringifiers = MemberStringifiersMap(),
+                              const TypeStringifiersMap& typeStringifiers = TypeStringifiersMap());
+
+    template<class T> bool write(T* object);
+    template<class T> bool write(const QList<T*>& objects);
+    bool flush();
+    bool finish();
+
+    void setChunkSize(int bytes) { m_chunkSize = bytes; }
+    void setMaxPendingBytes(qint64 bytes) { m_maxPendingBytes = bytes; }
+    void setWriteTimeout(int msecs) { m_writeTimeout = msecs; }
+    void setCodec(const QSharedPointer<Codec>& codec) { m_codec = codec; }
+
+    Serializer& serializer() { return m_serializer; }
+    qint64 bytesWritten() const { return m_bytesWritten; }
+    int count() const { return m_count; }
+    bool hasError() const { return !m_errorString.isEmpty(); }
+    QString errorString() const { return m_errorString; }
+
+private:
+    bool beginElement();
+    bool endElement();
+    bool drain(bool last);
+    bool waitForDevice();
+
+private:
+    QIODevice* m_device;
+    Mode m_mode;
+    Serializer m_serializer;
+    QByteArray m_buffer;
+    QByteArray m_encoded;
+    JsonWriter m_writer;
+    QSharedPointer<Codec> m_codec;
+    int m_chunkSize;
+    qint64 m_maxPendingBytes;
+    int m_writeTimeout;
+    qint64 m_bytesWritten;
+    int m_count;
+    bool m_finished;
+    QString m_errorString;
+};
+
+template<class T>
+bool StreamSerializer::write(T* object)
+{
+    if (!beginElement())
+        return false;
+
+    if (object)
+        m_serializer.writeObject(m_writer, object, &T::staticMetaObject);
+    else
+        m_writer.writeValue(QJsonValue::Null);
+
+    return endElement();
+}
+
+template<class T>
+bool StreamSerializer::write(const QList<T*>& objects)
+{
+    for (T* object : objects)
+        if (!write(object))
+            return false;
+    return true;
+}
+
+///
+/// \brief The SerializationCache class serializes QObject trees and keeps the JSON of
+/// each object, connecting to the notify signals of its properties. When a property
+/// changes, only that object and the objects containing it are serialized again.
+/// Objects with properties that have no notify signal are never cached. QObject's held
+/// by gadgets are serialized with the gadget but not tracked: call invalidate() on the
+/// object holding the gadget when they change.
+///
+class SerializationCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SerializationCache(const MemberStringifiersMap& memberStringifiers = MemberStringifiersMap(),
+                                const TypeStringifiersMap& typeStringifiers = TypeStringifiersMap(),
+                                QObject* parent = nullptr);
+
+    QJsonObject serialize(QObject* object);
+    void invalidate(QObject* object);
+    void clear();
+
+    Serializer& serializer() { return m_serializer; }
+    int renderCount() const { return m_renderCount; }
+
+private slots:
+    void onPropertyChanged();
+    void onDestroyed(QObject* object);
+
+private:
+    struct Entry
+    {
+        QJsonObject json;
+        bool dirty;
+        bool cacheable;
+        QSet<QObject*> parents;
+        QSet<QObject*> children;
+    };
+
+    void track(QObject* object);
+    QJsonObject render(QObject* object);
+    QJsonValue renderChild(QObject* parent, QObject* child);
+    QJsonValue renderValue(QObject* object, const QMetaProperty& metaProp, const QVariant& value);
+    void markDirty(QObject* object);
+    void unlinkChildren(QObject* object);
+
+private:
+    Serializer m_serializer;
+    QHash<QObject*, Entry> m_entries;
+    int m_renderCount;
+    bool m_uncachedChild;
+};
+
+///
+/// \brief The ObjectListModel class is a list model of QObject's, which it owns. Each
+/// property of the metaObject passed to the constructor is exposed as a role with the
+/// same name; the "object" role returns the QObject itself.
+///
+class ObjectListModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+public:
+    enum Roles {
+        ObjectRole = Qt::UserRole + 1,
+        FirstPropertyRole
+    };
+
+    explicit ObjectListModel(const QMetaObject* metaObject, QObject* parent = nullptr);
+    ~ObjectListModel();
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    int count() const { return m_objects.size(); }
+    QObject* at(int row) const { return m_objects.at(row); }
+    void append(const QList<QObject*>& objects);
+    void clear();
+
+signals:
+    void countChanged();
+
+private:
+    const QMetaObject* m_metaObject;
+    QList<QObject*> m_objects;
+};
+
+///
+/// \brief The Serializer class can be used to deserialize a JSON to a QObject or a gadget.
+///
+template<class T>
+class Deserializer
+{
+public:
+    Deserializer(const MemberStringifiersMap& stringifiers = MemberStringifiersMap(),
+                 const TypeStringifiersMap& typeStringifiers = TypeStringifiersMap());
+    T* deserialize(const QJsonObject& json);
+    T* deserialize(const QString& jsonString);
+    T* deserialize(const QByteArray& json);
+    T* deserialize(const char* json);
+    bool populate(const QByteArray& json, T* object);
+    QFuture<T*> deserializeAsync(const QByteArray& json,
+                                 QDeadlineTimer deadline = QDeadlineTimer(QDeadlineTimer::Forever),
+                                 QThreadPool* pool = QThreadPool::globalInstance(),
+                                 const QSharedPointer<QVector<Error> >& errors = QSharedPointer<QVector<Error> >());
+    QList<QString> deserializeStringArray(const QJsonArray& array);
+    QList<double>  deserializeNumberArray(const QJsonArray& array);
+    QList<bool>    deserializeBoolArray(const QJsonArray& array);
+    QList<T*>      deserializeObjectArray(const QJsonArray &array);
+    bool           validate(LByteArrayView json);
+
+    static void lserializerRegisterObject(const QMetaObject& metaObject);
+
+    const Instrumentation& instrumentation() const { return m_instrumentation; }
+    void setStatsCollector(const QSharedPointer<StatsCollector>& collector) { m_statsCollector = collector; }
+    QSharedPointer<StatsCollector> statsCollector() const { return m_statsCollector; }
+
+    const QVector<Error>& errors() const { return m_errors; }
+    int errorCount() const { return m_errorCount; }
+    void setMaxErrors(int maxErrors) { m_maxErrors = maxErrors; }
+    void setStrict(bool strict) { m_strict = strict; }
+    void setLoggingEnabled(bool enabled, int maxPerSecond = 10) { m_logLimiter.setEnabled(enabled, maxPerSecond); }
+    void setNotificationMode(NotificationMode mode) { m_notificationMode = mode; }
+    void setTreeReplacedHandler(const std::function<void(T*)>& handler) { m_treeReplacedHandler = handler; }
+    void setLimits(const Limits& limits) { m_limits = limits; m_limitScanner.reset(limits); }
+    const Limits& limits() const { return m_limits; }
+    void setMemoryAccounting(bool enabled) { m_memoryAccounting = enabled; }
+    const MemoryReport& memoryReport() const { return m_memoryReport; }
+
+protected:
+    void deserializeJson(QJsonObject json,
+                         void* dest,
+                         const QMetaObject* metaObject);
+    void deserializeMember(const QString& key,
+                           const QJsonValue& value,
+                           void* dest,
+                           bool isGadget,
+                           const QMetaObject* metaObject);
+    void deserializeValue(const QJsonValue& value,
+                          const QMetaProperty& metaProp,
+                          const PropertyKernel& kernel,
+                          void* dest,
+                          bool isGadget,
+                          const QMetaObject* metaObject);
+    void deserializeArray(const QJsonArray& array,
+                          const QMetaProperty& metaProp,
+                          const PropertyKernel& kernel,
+                          void* dest,
+                          bool isGadget);
+    void deserializeObjectArray(const QJsonArray& array,
+                                const QMetaProperty& metaProp,
+                                const QString& type,
+                                void* dest,
+                                bool isGadget);
+    void validateObject(JsonReader& reader, const QMetaObject* metaObject);
+    void validateValue(JsonReader& reader,
+                       int typeId,
+                       const char* propName,
+                       const QMetaObject* metaObject,
+                       bool member);
+    void validateArray(JsonReader& reader, int typeId, const char* propName, const QMetaObject* metaObject);
+    bool convertible(const QJsonValue& value, int typeId, const char* propName, const QMetaObject* metaObject);
+    const ObjectPlan& plan(const QMetaObject* metaObject);
+    void deserializeSharedGadget(const QJsonValue& value,
+                                 const SharedGadgetKernel& kernel,
+                                 const QMetaProperty& metaProp,
+                                 void* dest,
+                                 bool isGadget);
+    void deserializeDictionary(const QJsonObject& object,
+                               const DictionaryKernel& kernel,
+                               const QMetaProperty& metaProp,
+                               void* dest,
+                               bool isGadget);
+    void addObjectArray(const QJsonArray& array,
+                        const QMetaProperty& metaProp,
+                        const QMetaType& metaType,
+                        QObject* dest);
+    void* instantiateObject(const QJsonValue& value,
+                            const QMetaType& metaType,
+                            bool isGadget,
+                            QObject* parent);
+    QVariant destringify(const QString& value,
+                         const QMetaProperty& metaProp,
+                         const QMetaObject* metaObject);
+    bool deserializeUtf8(const QByteArray& value, const QMetaProperty& metaProp, void* dest, bool isGadget);
+    const QMetaObject* concreteType(const QJsonObject& json, const QMetaObject* metaObject);
+
+protected:
+    void writeProp(const QMetaProperty& metaProp, void* dest, const QVariant& value, bool isGadget);
+    void quiet(QObject* object, int propertyIndex);
+    const char* checkInput(const char* data, qsizetype size);
+    void exceedLimit(const char* limit, const QMetaObject* metaObject);
+    void measureMemory(T* object);
+    void flushNotifications();
+    void treeReplaced(T* object);
+    bool interrupted();
+    void beginCall();
+    void endCall();
+    T* deserializeRoot(const QJsonObject& json);
+    T* instantiateRoot(const QJsonObject& json);
+    void reportError(Error::Code code, const char* property, const QMetaObject* metaObject);
+    int metatype_from_name(const QString& typeName) {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        return QMetaType::fromName(typeName.toLatin1()).id();
+#else
+        return QMetaType::type(typeName.toLatin1().data());
+#endif
+    }
+
+protected:
+    Path m_path;
+
+private:
+    struct QuietObject
+    {
+        QPointer<QObject> object;
+        bool wasBlocked;
+        QVector<int> properties;
+    };
+
+    struct PendingParent
+    {
+        QPointer<QObject> child;
+        QPointer<QObject> parent;
+    };
+
+private:
+    QRegularExpression m_arrayTypeRegex;
+    MemberStringifiersMap m_memberStringifiers;
+    TypeStringifiersMap m_typeStringifiers;
+    Instrumentation m_instrumentation;
+    QSharedPointer<StatsCollector> m_statsCollector;
+    StatsScope* m_statsScope = nullptr;
+    std::function<bool()> m_interruptCheck;
+    bool m_aborted = false;
+    // Set when m_aborted comes from m_interruptCheck rather than from an error.
+    bool m_interrupted = false;
+    QVector<Error> m_errors;
+    int m_errorCount = 0;
+    int m_maxErrors = -1;
+    bool m_strict = false;
+    LogRateLimiter m_logLimiter;
+    QHash<const QMetaObject*, ObjectPlan> m_plans;
+    int m_plansGeneration = -1;
+    QHash<quint64, QVector<SharedInstance> > m_sharedInstances;
+    NotificationMode m_notificationMode = ImmediateNotifications;
+    Limits m_limits;
+    LimitScanner m_limitScanner;
+    qint64 m_inputBytes = 0;
+    bool m_memoryAccounting = false;
+    MemoryReport m_memoryReport;
+    QVector<QuietObject> m_quietObjects;
+    QHash<QObject*, int> m_quietIndex;
+    QVector<PendingParent> m_pendingParents;
+    std::function<void(T*)> m_treeReplacedHandler;
+};
+
+inline Stringifier* find_stringifier(const QMetaObject* metaObject,
+                                     const char* propName,
+                                     const QMetaType& metaType,
+                                     const MemberStringifiersMap& memberStringifiers,
+                                     const TypeStringifiersMap& typeStringifiers)
+{
+    if (!metaObject)
+        return nullptr;
+
+    const int classInfoIndex = metaObject->indexOfClassInfo(propName);
+    if (classInfoIndex >= 0) {
+        const QString stringifierName = QString(metaObject->classInfo(classInfoIndex).value());
+        if (memberStringifiers.contains(stringifierName))
+            return memberStringifiers.value(stringifierName).data();
+    }
+
+    if (typeStringifiers.contains(metaType.id()))
+        return typeStringifiers.value(metaType.id()).data();
+
+    return nullptr;
+}
+
+template<class T>
+QVariant deserialize_array(const QJsonArray& array, std::function<T(const QJsonValue& jsonValue)> convert)
+{
+    QJsonArray::const_iterator it = array.constBegin();
+    QList<T> list;
+    while (it != array.constEnd()) {
+        list.append(convert(*it));
+        ++it;
+    }
+
+    return QVariant::fromValue(list);
+}
+
+///
+/// \brief deserialize_typed_array converts an array of values to QList<T> or, for
+/// nested arrays, to QList<QList<T>>, without boxing the elements in QVariant's.
+///
+template<class T>
+QList<T> deserialize_typed_list(const QJsonArray& array, T (*convert)(const QJsonValue&))
+{
+    QList<T> list;
+    list.reserve(array.size());
+    for (const QJsonValue& value : array)
+        list.append(convert(value));
+    return list;
+}
+
+template<class T>
+QVariant deserialize_typed_array(const QJsonArray& array, int depth, T (*convert)(const QJsonValue&))
+{
+    if (depth == 1)
+        return QVariant::fromValue(deserialize_typed_list<T>(array, convert));
+
+    QList<QList<T> > list;
+    list.reserve(array.size());
+    for (const QJsonValue& value : array)
+        list.append(deserialize_typed_list<T>(value.toArray(), convert));
+    return QVariant::fromValue(list);
+}
+
+void move_gadget_objects(const void* gadget, const QMetaObject* metaObject, QThread* thread);
+void emit_notify_signal(QObject* object, const QMetaMethod& signal, const QVariant& value);
+
+inline void destroy_gadget(void* gadget, const QMetaObject* metaObject)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    metaObject->metaType().destroy(gadget);
+#else
+    QMetaType::destroy(QMetaType::type(metaObject->className()), gadget);
+#endif
+}
+
+template<class T>
+T* new_instance(const QMetaObject* metaObject, std::true_type)
+{
+    if (metaObject == &T::staticMetaObject)
+        return new T;
+    return static_cast<T*>(metaObject->newInstance());
+}
+
+template<class T>
+T* new_instance(const QMetaObject*, std::false_type)
+{
+    return new T;
+}
+
+template<class T>
+void move_to_thread(T* object, QThread* thread, std::true_type)
+{
+    object->moveToThread(thread);
+}
+
+template<class T>
+void move_to_thread(T* object, QThread* thread, std::false_type)
+{
+    move_gadget_objects(object, &T::staticMetaObject, thread);
+}
+
+template<class T>
+Deserializer<T>::Deserializer(const MemberStringifiersMap& memberStringifiers, const TypeStringifiersMap& typeStringifiers) :
+    m_arrayTypeRegex(QStringLiteral("^(QList)<([^\\*]+(\\*){0,1})>$"))
+  , m_memberStringifiers(memberStringifiers)
+  , m_typeStringifiers(typeStringifiers) {}
+
+template<class T>
+T* Deserializer<T>::deserialize(const QJsonObject& json)
+{
+    L_INSTR_CALL(m_instrumentation);
+    beginCall();
+    T* t = nullptr;
+    if (const char* limit = check_json_limits(json, m_limits))
+        exceedLimit(limit, &T::staticMetaObject);
+    else
+        t = deserializeRoot(json);
+    endCall();
+    return t;
+}
+
+template<class T>
+T* Deserializer<T>::deserialize(const QString& jsonString)
+{
+    return deserialize(jsonString.toUtf8());
+}
+
+template<class T>
+T* Deserializer<T>::deserialize(const QByteArray& json)
+{
+    L_INSTR_CALL(m_instrumentation);
+    beginCall();
+    if (m_statsCollector)
+        m_statsCollector->recordBytesIn(&T::staticMetaObject, json.size());
+    T* t = nullptr;
+    if (!checkInput(json.constData(), json.size())) {
+        QJsonParseError error;
+        QJsonDocument doc = QJsonDocument::fromJson(json, &error);
+        if (error.error != QJsonParseError::NoError)
+            reportError(Error::ParseError, nullptr, &T::staticMetaObject);
+        if (!interrupted())
+            t = deserializeRoot(doc.object());
+    }
+    endCall();
+    return t;
+}
+
+template<class T>
+T* Deserializer<T>::deserialize(const char* json)
+{
+    return deserialize(QByteArray(json));
+}
+
+///
+/// \brief Deserializer<T>::populate deserializes json into an existing object, e.g. one
+/// already exposed to QML. Returns false if the deserialization was aborted, in which
+/// case the object may be partially populated.
+///
+template<class T>
+bool Deserializer<T>::populate(const QByteArray& json, T* object)
+{
+    L_INSTR_CALL(m_instrumentation);
+    beginCall();
+    if (m_statsCollector)
+        m_statsCollector->recordBytesIn(&T::staticMetaObject, json.size());
+    if (!checkInput(json.constData(), json.size())) {
+        QJsonParseError error;
+        QJsonDocument doc = QJsonDocument::fromJson(json, &error);
+        if (error.error != QJsonParseError::NoError)
+            reportError(Error::ParseError, nullptr, &T::staticMetaObject);
+        if (!interrupted())
+            deserializeJson(doc.object(), object, &T::staticMetaObject);
+    }
+    flushNotifications();
+    endCall();
+    if (m_aborted)
+        return false;
+
+    measureMemory(object);
+    treeReplaced(object);
+    return true;
+}
+
+///
+/// \brief Deserializer<T>::deserializeAsync parses the JSON and builds the object in
+/// a thread of the pool. QObject's, including those held by gadgets, are moved to the
+/// thread calling this method before the result is reported. Canceling the future or
+/// expiring the deadline abandons the deserialization at the next object boundary; the
+/// future is then canceled and no result is reported. If the JSON cannot be
+/// deserialized, the result is nullptr and the errors are stored into errors, when
+/// provided, before the future finishes. A parse error or an error in strict mode is
+/// reported this way even if the deadline expired in the meantime.
+///
+/// The reported object is owned by the caller, who must take it with result() and
+/// delete it. QFuture does not delete its results: if the caller may drop the future
+/// without reading it, cancel it before it finishes, so the object is deleted in the
+/// pool instead.
+///
+template<class T>
+QFuture<T*> Deserializer<T>::deserializeAsync(const QByteArray& json,
+                                              QDeadlineTimer deadline,
+                                              QThreadPool* pool,
+                                              const QSharedPointer<QVector<Error> >& errors)
+{
+    QSharedPointer<QFutureInterface<T*>> promise(new QFutureInterface<T*>);
+    promise->reportStarted();
+    QFuture<T*> future = promise->future();
+
+    QThread* targetThread = QThread::currentThread();
+    Deserializer<T> deserializer(*this);
+    deserializer.m_interruptCheck = [promise, deadline] () -> bool {
+        return promise->isCanceled() || deadline.hasExpired();
+    };
+
+    pool->start(QRunnable::create([promise, deserializer, json, targetThread, errors] () mutable {
+        T* t = deserializer.deserialize(json);
+        if (errors)
+            *errors = deserializer.errors();
+        if (promise->isCanceled() || deserializer.m_interrupted) {
+            delete t;
+            promise->reportCanceled();
+            promise->reportFinished();
+            return;
+        }
+
+        if (!t) {
+            promise->reportResult(t);
+            promise->reportFinished();
+            return;
+        }
+
+        move_to_thread(t, targetThread, std::is_base_of<QObject, T>());
+        promise->reportResult(t);
+        promise->reportFinished();
+    }));
+
+    return future;
+}
+
+template<class T>
+QList<QString> Deserializer<T>::deserializeStringArray(const QJsonArray& array)
+{
+    return deserialize_array<QString>(array, [] (const QJsonValue& jsonValue) -> QString {
+        return jsonValue.toString();
+    }).toStringList();
+}
+
+template<class T>
+QList<double> Deserializer<T>::deserializeNumberArray(const QJsonArray& array)
+{
+    QVariant v = deserialize_array<double>(array, [] (const QJsonValue& jsonValue) -> double {
+        return jsonValue.toDouble();
+    });
+    return v.value<QList<double>>();
+}
+
+template<class T>
+QList<bool> Deserializer<T>::deserializeBoolArray(const QJsonArray &array)
+{
+    QVariant v = deserialize_array<bool>(array, [] (const QJsonValue& jsonValue) -> bool {
+        return jsonValue.toBool();
+    });
+    return v.value<QList<bool>>();
+}
+
+///
+/// \brief Deserializer<T>::deserializeObjectArray deserializes an array of T. Elements are
+/// created like the root, so polymorphic subtypes are honored, and null elements are
+/// returned as nullptr. The caller owns the returned objects; if the deserialization is
+/// aborted, they are deleted and an empty list is returned.
+///
+template<class T>
+QList<T*> Deserializer<T>::deserializeObjectArray(const QJsonArray& array)
+{
+    L_INSTR_CALL(m_instrumentation);
+    beginCall();
+    if (const char* limit = check_json_limits(array, m_limits)) {
+        exceedLimit(limit, &T::staticMetaObject);
+        endCall();
+        return QList<T*>();
+    }
+
+    QList<T*> ret;
+    ret.reserve(array.size());
+    int index = 0;
+    QJsonArray::const_iterator it = array.constBegin();
+    for (; it != array.constEnd() && !interrupted(); ++it, ++index) {
+        PathGuard pathGuard(m_path, index);
+        if ((*it).type() == QJsonValue::Null || (*it).type() == QJsonValue::Undefined)
+            ret.append(nullptr);
+        else
+            ret.append(instantiateRoot((*it).toObject()));
+    }
+    flushNotifications();
+    endCall();
+    if (m_aborted) {
+        qDeleteAll(ret);
+        return QList<T*>();
+    }
+
+    for (T* t : ret)
+        measureMemory(t);
+    return ret;
+}
+
+template<class T>
+void Deserializer<T>::deserializeJson(QJsonObject json, void* dest, const QMetaObject* metaObject)
+{
+    if (interrupted())
+        return;
+
+    StatsScope statsScope(m_statsCollector.data(), metaObject, &m_statsScope);
+    bool isGadget = !metaObject->inherits(&QObject::staticMetaObject);
+    QJsonObject::const_iterator it = json.constBegin();
+    while (it != json.constEnd() && !m_aborted) {
+        deserializeMember(it.key(), it.value(), dest, isGadget, metaObject);
+        ++it;
+    }
+}
+
+template<class T>
+void Deserializer<T>::deserializeMember(const QString& key,
+                                        const QJsonValue& value,
+                                        void* dest,
+                                        bool isGadget,
+                                        const QMetaObject* metaObject)
+{
+    const ObjectPlan& objectPlan = plan(metaObject);
+    QHash<QString, int>::const_iterator it = objectPlan.properties.constFind(key);
+    if (it == objectPlan.properties.constEnd())
+        return;
+
+    // Copied, as the plans may grow while the value is deserialized.
+    const PropertyKernel kernel = objectPlan.kernels.at(it.value());
+    PathGuard pathGuard(m_path, &key);
+    deserializeValue(value, metaObject->property(it.value()), kernel, dest, isGadget, metaObject);
+}
+
+template<class T>
+const ObjectPlan& Deserializer<T>::plan(const QMetaObject* metaObject)
+{
+    const int generation = registry_generation();
+    if (generation != m_plansGeneration) {
+        m_plans.clear();
+        m_plansGeneration = generation;
+    }
+
+    typename QHash<const QMetaObject*, ObjectPlan>::iterator it = m_plans.find(metaObject);
+    if (it == m_plans.end())
+        it = m_plans.insert(metaObject, make_object_plan(metaObject));
+    return it.value();
+}
+
+///
+/// \brief Deserializer<T>::validate checks a document against the model without
+/// instantiating it. Unknown keys, values that cannot be stored in their property
+/// and missing required properties are reported in errors(), in document order. The
+/// text is read in a single pass with JsonReader, without building a QJsonDocument.
+///
+template<class T>
+bool Deserializer<T>::validate(LByteArrayView json)
+{
+    L_INSTR_CALL(m_instrumentation);
+    beginCall();
+    if (m_statsCollector)
+        m_statsCollector->recordBytesIn(&T::staticMetaObject, json.size());
+    if (checkInput(json.data(), json.size())) {
+        endCall();
+        return false;
+    }
+
+    JsonReader reader(json.data(), json.size());
+    if (reader.peek() == JsonReader::Object)
+        validateObject(reader, &T::staticMetaObject);
+    else if (!reader.hasError()) {
+        reportError(Error::TypeMismatch, nullptr, &T::staticMetaObject);
+        reader.skipValue();
+    }
+
+    // Trailing data is only checked if the document was read to the end.
+    if (reader.hasError() || (!m_aborted && !reader.atEnd()))
+        reportError(Error::ParseError, nullptr, &T::staticMetaObject);
+
+    endCall();
+    return m_errorCount == 0;
+}
+
+///
+/// \brief Deserializer<T>::validateObject validates the object at the position of reader
+/// and moves past it. The discriminator of polymorphic types is looked up first, as
+/// it may follow other members.
+///
+template<class T>
+void Deserializer<T>::validateObject(JsonReader& reader, const QMetaObject* metaObject)
+{
+    // Plans are copied, as the hash may grow while nested objects are validated.
+    ObjectPlan objectPlan = plan(metaObject);
+    if (!objectPlan.subtypes.isEmpty()) {
+        QJsonObject header;
+        const QJsonValue discriminator = reader.peekMember(objectPlan.discriminator.toUtf8());
+        if (!discriminator.isUndefined())
+            header.insert(objectPlan.discriminator, discriminator);
+        metaObject = concreteType(header, metaObject);
+        if (!metaObject) {
+            reader.skipValue();
+            return;
+        }
+        objectPlan = plan(metaObject);
+    }
+
+    if (!reader.beginObject())
+        return;
+
+    QVector<bool> found(objectPlan.required.size(), false);
+    QByteArray utf8Key;
+    while (!interrupted() && reader.nextMember(&utf8Key)) {
+        const QString key = QString::fromUtf8(utf8Key);
+        PathGuard pathGuard(m_path, &key);
+        QHash<QString, int>::const_iterator propIt = objectPlan.properties.constFind(key);
+        if (propIt == objectPlan.properties.constEnd()) {
+            if (key != objectPlan.typeKey && key != objectPlan.discriminator)
+                reportError(Error::UnknownKey, key.toLatin1().constData(), metaObject);
+            reader.skipValue();
+            continue;
+        }
+
+        const int requiredIndex = objectPlan.required.indexOf(key);
+        if (requiredIndex >= 0)
+            found[requiredIndex] = true;
+
+        const QMetaProperty metaProp = metaObject->property(propIt.value());
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        const int typeId = metaProp.metaType().id();
+#else
+        const int typeId = QMetaType::type(metaProp.typeName());
+#endif
+        validateValue(reader, typeId, metaProp.name(), metaObject, true);
+    }
+
+    if (m_aborted || reader.hasError())
+        return;
+
+    for (int i = 0; i < objectPlan.required.size(); i++)
+        if (!found.at(i))
+            reportError(Error::MissingRequired, objectPlan.required.at(i).toLatin1().constData(), metaObject);
+}
+
+///
+/// \brief Deserializer<T>::validateValue validates the value at the position of reader
+/// and moves past it. member is false for elements of arrays and dictionaries, which
+/// are not destringified.
+///
+template<class T>
+void Deserializer<T>::validateValue(JsonReader& reader,
+                                    int typeId,
+                                    const char* propName,
+                                    const QMetaObject* metaObject,
+                                    bool member)
+{
+    const JsonReader::Type type = reader.peek();
+    if (type == JsonReader::Null || typeId == QMetaType::QVariant || typeId == qMetaTypeId<RawJson>()) {
+        reader.skipValue();
+        return;
+    }
+
+    const QMetaType metaType(typeId);
+    switch (type) {
+    case JsonReader::Invalid:
+        return;
+    case JsonReader::Array:
+        if (typeId == QMetaType::QVariantList) {
+            reader.skipValue();
+            return;
+        }
+        validateArray(reader, typeId, propName, metaObject);
+        return;
+    case JsonReader::Object: {
+        if (typeId == QMetaType::QVariantMap || typeId == QMetaType::QVariantHash) {
+            reader.skipValue();
+            return;
+        }
+        if (metaType.flags().testFlag(QMetaType::PointerToQObject)
+                || metaType.flags().testFlag(QMetaType::PointerToGadget)) {
+            validateObject(reader, metaType.metaObject());
+            return;
+        }
+
+        SharedGadgetKernel sharedKernel;
+        if (shared_gadget_kernel(typeId, &sharedKernel)) {
+            validateObject(reader, QMetaType(sharedKernel.gadgetPointerType).metaObject());
+            return;
+        }
+
+        DictionaryKernel kernel;
+        if (!dictionary_kernel(typeId, &kernel)) {
+            reportError(Error::TypeMismatch, propName, metaObject);
+            reader.skipValue();
+            return;
+        }
+
+        reader.beginObject();
+        QByteArray utf8Key;
+        while (!interrupted() && reader.nextMember(&utf8Key)) {
+            const QString key = QString::fromUtf8(utf8Key);
+            PathGuard pathGuard(m_path, &key);
+            validateValue(reader, kernel.valueType, propName, metaObject, false);
+        }
+        return;
+    }
+    default: {
+        const QJsonValue value = reader.readScalar();
+        if (!reader.hasError() && !convertible(value, typeId, propName, member ? metaObject : nullptr))
+            reportError(Error::TypeMismatch, propName, metaObject);
+        return;
+    }
+    }
+}
+
+///
+/// \brief Deserializer<T>::validateArray validates the array at the position of reader
+/// and moves past it.
+///
+template<class T>
+void Deserializer<T>::validateArray(JsonReader& reader, int typeId, const char* propName, const QMetaObject* metaObject)
+{
+    ColumnarKernel columnarKernel;
+    GadgetArrayKernel kernel;
+    const bool columnar = columnar_kernel(typeId, &columnarKernel);
+    const bool gadgetArray = !columnar && gadget_array_kernel(typeId, &kernel);
+    if (columnar || gadgetArray) {
+        const QMetaObject* elementMetaObject = columnar ? columnarKernel.metaObject : kernel.metaObject;
+        reader.beginArray();
+        for (int i = 0; !interrupted() && reader.nextElement(); i++) {
+            PathGuard pathGuard(m_path, i);
+            const JsonReader::Type type = reader.peek();
+            if (type == JsonReader::Object)
+                validateObject(reader, elementMetaObject);
+            else {
+                // Columns keep null rows, gadget arrays have no null elements.
+                if (type != JsonReader::Invalid && (gadgetArray || type != JsonReader::Null))
+                    reportError(Error::TypeMismatch, propName, metaObject);
+                reader.skipValue();
+            }
+        }
+        return;
+    }
+
+    int elementType = QMetaType::UnknownType;
+    if (typeId == QMetaType::QStringList)
+        elementType = QMetaType::QString;
+    else {
+        const QRegularExpressionMatch match = m_arrayTypeRegex.match(QString::fromLatin1(QMetaType(typeId).name()));
+        if (match.hasMatch())
+            elementType = metatype_from_name(match.captured(2).trimmed());
+    }
+
+    if (elementType == QMetaType::UnknownType) {
+        reportError(Error::TypeMismatch, propName, metaObject);
+        reader.skipValue();
+        return;
+    }
+
+    reader.beginArray();
+    for (int i = 0; !interrupted() && reader.nextElement(); i++) {
+        PathGuard pathGuard(m_path, i);
+        validateValue(reader, elementType, propName, metaObject, false);
+    }
+}
+
+///
+/// \brief Deserializer<T>::convertible returns whether value can be stored in a property
+/// of type typeId. Strings are checked with the stringifier of the member first, like
+/// destringify() does; metaObject is nullptr for values that are not members.
+///
+template<class T>
+bool Deserializer<T>::convertible(const QJsonValue& value, int typeId, const char* propName, const QMetaObject* metaObject)
+{
+    int sourceType;
+    switch (value.type()) {
+    case QJsonValue::Bool:
+        sourceType = QMetaType::Bool;
+        break;
+    case QJsonValue::Double:
+        sourceType = QMetaType::Double;
+        break;
+    case QJsonValue::String: {
+        const QString string = value.toString();
+        Stringifier* stringifier = find_stringifier(metaObject,
+                                                    propName,
+                                                    QMetaType(typeId),
+                                                    m_memberStringifiers,
+                                                    m_typeStringifiers);
+        if (stringifier && !stringifier->destringify(string).isNull())
+            return true;
+        if (typeId == QMetaType::QString || typeId == QMetaType::QByteArray)
+            return true;
+
+        // Without a stringifier the string is converted by Qt, which may fail.
+        QVariant variant(string);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        return variant.convert(QMetaType(typeId));
+#else
+        return variant.convert(typeId);
+#endif
+    }
+    default:
+        return false;
+    }
+
+    if (sourceType == typeId)
+        return true;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    return QMetaType::canConvert(QMetaType(sourceType), QMetaType(typeId));
+#else
+    return QVariant(QVariant::Type(sourceType)).canConvert(typeId);
+#endif
+}
+
+template<class T>
+void Deserializer<T>::deserializeArray(const QJsonArray& array,
+                                        const QMetaProperty& metaProp,
+                                        const PropertyKernel& kernel,
+                                        void* dest,
+                                        bool isGadget)
+{
+#ifdef DEBUG_LQOBJECTSERIALIZER
+    qDebug() << "Deserialize array:" << metaProp.typeName() << metaProp.name();
+#endif
+    if (kernel.kind == PropertyKernel::Columnar) {
+        Columns* columns;
+        const QVariant value = kernel.columnar.create(&columns);
+        columns->reserve(array.size());
+        for (int i = 0; i < array.size(); i++) {
+            PathGuard pathGuard(m_path, i);
+            const QJsonValue element = array.at(i);
+            if (element.isObject()) {
+                columns->appendRow(element.toObject());
+                continue;
+            }
+
+            if (!element.isNull())
+                reportError(Error::TypeMismatch, metaProp.name(), metaProp.enclosingMetaObject());
+            columns->appendNull();
+        }
+
+        writeProp(metaProp, dest, value, isGadget);
+        return;
+    }
+
+    if (kernel.kind == PropertyKernel::GadgetArray) {
+        const QMetaObject* elementMetaObject = kernel.gadgetArray.metaObject;
+        const QVariant list = kernel.gadgetArray.build(array, [this, elementMetaObject] (int index, void* element, const QJsonValue& value) {
+            if (interrupted())
+                return;
+            PathGuard pathGuard(m_path, index);
+            deserializeJson(value.toObject(), element, elementMetaObject);
+        });
+        writeProp(metaProp, dest, list, isGadget);
+        return;
+    }
+
+    QString container;
+    QString type;
+    if (metaProp.typeName() == QStringLiteral("QStringList")) {
+        container = QStringLiteral("QList");
+        type = QStringLiteral("QString");
+    }
+    else {
+        QRegularExpressionMatch match = m_arrayTypeRegex.match(metaProp.typeName());
+        if (!match.hasMatch()) {
+            reportError(Error::UnsupportedType, metaProp.name(), metaProp.enclosingMetaObject());
+            return;
+        }
+
+        container = match.captured(1);
+        type = match.captured(2).trimmed();
+    }
+
+    // Nested arrays, e.g. QList<QList<double>>. Qt 5 normalizes the type as
+    // QList<QList<double> >.
+    int depth = 1;
+    if (type.startsWith(QStringLiteral("QList<")) && type.endsWith(QLatin1Char('>'))) {
+        type = type.mid(6, type.length() - 7).trimmed();
+        depth = 2;
+    }
+
+    QVariant list;
+    if (type == QStringLiteral("int"))
+        list = deserialize_typed_array<int>(array, depth, [] (const QJsonValue& jsonValue) -> int {
+            return jsonValue.toInt();
+        });
+    else if (type == QStringLiteral("long"))
+        list = deserialize_typed_array<long>(array, depth, [] (const QJsonValue& jsonValue) -> long {
+            return jsonValue.toInt();
+        });
+    else if (type == QStringLiteral("float"))
+        list = deserialize_typed_array<float>(array, depth, [] (const QJsonValue& jsonValue) -> float {
+            return jsonValue.toDouble();
+        });
+    else if (type == QStringLiteral("double"))
+        list = deserialize_typed_array<double>(array, depth, [] (const QJsonValue& jsonValue) -> double {
+            return jsonValue.toDouble();
+        });
+    else if (type == QStringLiteral("QString"))
+        list = deserialize_typed_array<QString>(array, depth, [] (const QJsonValue& jsonValue) -> QString {
+            return jsonValue.toString();
+        });
+    else if (type == QStringLiteral("bool"))
+        list = deserialize_typed_array<bool>(array, depth, [] (const QJsonValue& jsonValue) -> bool {
+            return jsonValue.toBool();
+        });
+    else if (depth > 1) {
+        reportError(Error::UnsupportedType, metaProp.name(), metaProp.enclosingMetaObject());
+        return;
+    }
+
+    if (list.isValid())
+        writeProp(metaProp, dest, list, isGadget);
+    else {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        if (QMetaType::fromName(type.toLatin1()).id() != QMetaType::UnknownType)
+#else
+        if (QMetaType::type(type.toLatin1().data()) != QMetaType::UnknownType)
+#endif
+            deserializeObjectArray(array, metaProp, type, dest, isGadget);
+        else
+            reportError(Error::UnknownType, metaProp.name(), metaProp.enclosingMetaObject());
+    }
+
+    return;
+}
 
 template<class T>
-QList<T*> Deserializer<T>::deserializeObjectArray(const QJsonArray& array)
+void* Deserializer<T>::instantiateObject(const QJsonValue& value, const QMetaType& metaType, bool isGadget, QObject* parent)
+{
+    const QMetaObject* metaObject = metaType.metaObject();
+    if (metaType.id() == QMetaType::UnknownType || !metaObject) {
+        reportError(Error::UnknownType, nullptr, metaObject);
+        return nullptr;
+    }
+
+    const QJsonObject object = value.toObject();
+    if (!isGadget) {
+        if (!plan(metaObject).subtypes.isEmpty()) {
+            metaObject = concreteType(object, metaObject);
+            if (!metaObject)
+                return nullptr;
+        }
+
+        L_INSTR_COUNT(m_instrumentation, metaObject, instantiations);
+        QObject* child = metaObject->newInstance();
+        if (!child) {
+            reportError(Error::UnknownType, nullptr, metaObject);
+            return nullptr;
+        }
+        if (parent && m_notificationMode == ImmediateNotifications)
+            child->setParent(parent);
+        else if (parent) {
+            PendingParent pendingParent;
+            pendingParent.child = child;
+            pendingParent.parent = parent;
+            m_pendingParents.append(pendingParent);
+        }
+        deserializeJson(object, child, metaObject);
+        return child;
+    }
+    else {
+        L_INSTR_COUNT(m_instrumentation, metaObject, instantiations);
+        // Allocated by QMetaType and owned by whoever receives the pointer, which must
+        // release it with destroy_gadget() or the equivalent QMetaType::destroy().
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        void* gadget = metaObject->metaType().create(nullptr);
+#else
+        void* gadget = QMetaType::create(QMetaType::type(metaObject->className()));
+#endif
+        deserializeJson(object, gadget, metaObject);
+        return gadget;
+    }
+
+    return nullptr;
+}
+
+///
+/// \brief Deserializer<T>::concreteType returns the type selected by the discriminator of
+/// json among the registered subtypes of metaObject, or metaObject itself when json
+/// has no discriminator.
+///
+template<class T>
+const QMetaObject* Deserializer<T>::concreteType(const QJsonObject& json, const QMetaObject* metaObject)
+{
+    const ObjectPlan& objectPlan = plan(metaObject);
+    const QJsonValue discriminator = json.value(objectPlan.discriminator);
+    if (discriminator.isUndefined())
+        return metaObject;
+
+    QHash<QString, const QMetaObject*>::const_iterator it = objectPlan.subtypes.constFind(discriminator.toString());
+    if (it == objectPlan.subtypes.constEnd()) {
+        reportError(Error::UnknownType, objectPlan.discriminator.toLatin1().constData(), metaObject);
+        return nullptr;
+    }
+
+    return it.value();
+}
+
+template<class T>
+QVariant Deserializer<T>::destringify(const QString& value,
+                                      const QMetaProperty& metaProp,
+                                      const QMetaObject* metaObject)
+{
+    Stringifier* strigifier = find_stringifier(metaObject,
+                                               metaProp.name(),
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+                                               metaProp.metaType(),
+#else
+                                               QMetaType(QMetaType::type(metaProp.typeName())),
+#endif
+
+                                               m_memberStringifiers,
+                                               m_typeStringifiers);
+    if (!strigifier)
+        return QVariant();
+
+    return strigifier->destringify(value);
+}
+
+///
+/// \brief Deserializer<T>::deserializeUtf8 stores the JSON string value into a QByteArray
+/// property without decoding it to a QString. Returns false, writing nothing, if the
+/// property is not a QByteArray, has a stringifier or value is not a valid string.
+///
+template<class T>
+bool Deserializer<T>::deserializeUtf8(const QByteArray& value, const QMetaProperty& metaProp, void* dest, bool isGadget)
+{
+    if (metaProp.userType() != QMetaType::QByteArray)
+        return false;
+    if (find_stringifier(metaProp.enclosingMetaObject(),
+                         metaProp.name(),
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+                         metaProp.metaType(),
+#else
+                         QMetaType(QMetaType::QByteArray),
+#endif
+                         m_memberStringifiers,
+                         m_typeStringifiers))
+        return false;
+
+    JsonReader reader(value.constData(), value.size());
+    if (reader.peek() != JsonReader::String)
+        return false;
+    QByteArray utf8;
+    if (!reader.readString(&utf8) || !reader.atEnd())
+        return false;
+
+    writeProp(metaProp, dest, utf8, isGadget);
+    return true;
+}
+
+template<class T>
+void Deserializer<T>::deserializeValue(const QJsonValue& value,
+                                        const QMetaProperty& metaProp,
+                                        const PropertyKernel& kernel,
+                                        void* dest,
+                                        bool isGadget,
+                                        const QMetaObject* metaObject)
+{
+    // Also registers the type before it is looked up by name.
+    const int rawJsonType = qMetaTypeId<RawJson>();
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    int typeId = metaProp.metaType().id();
+#else
+    int typeId = QMetaType::type(metaProp.typeName());
+#endif
+
+    if (typeId == rawJsonType) {
+        writeProp(metaProp, dest, QVariant::fromValue(RawJson(value)), isGadget);
+        return;
+    }
+
+    switch (typeId) {
+    case QMetaType::QVariant:
+        writeProp(metaProp, dest, value.toVariant(), isGadget);
+        return;
+    case QMetaType::QVariantHash:
+        writeProp(metaProp, dest, value.toVariant().toHash(), isGadget);
+        return;
+    case QMetaType::QVariantMap:
+        writeProp(metaProp, dest, value.toVariant().toMap(), isGadget);
+        return;
+    case QMetaType::QVariantList:
+        writeProp(metaProp, dest, value.toVariant().toList(), isGadget);
+        return;
+    default:
+        break;
+    }
+
+    switch (value.type()) {
+    case QJsonValue::Null:
+    case QJsonValue::Undefined:
+        writeProp(metaProp, dest, QVariant(), isGadget);
+        break;
+    case QJsonValue::Bool:
+        writeProp(metaProp, dest, value.toBool(), isGadget);
+        break;
+    case QJsonValue::Double:
+        if (typeId == QMetaType::LongLong)
+            writeProp(metaProp, dest, json_to<qlonglong>(value), isGadget);
+        else
+            writeProp(metaProp, dest, value.toDouble(), isGadget);
+        break;
+    case QJsonValue::String: {
+        // With Qt 6 each call to toString() builds a new QString.
+        const QString string = value.toString();
+        const QVariant destringified = destringify(string, metaProp, metaObject);
+        if (!destringified.isNull())
+            writeProp(metaProp, dest, destringified, isGadget);
+        else if (typeId == QMetaType::QByteArray)
+            writeProp(metaProp, dest, string.toUtf8(), isGadget);
+        else
+            writeProp(metaProp, dest, string, isGadget);
+        break;
+    }
+    case QJsonValue::Array:
+        deserializeArray(value.toArray(), metaProp, kernel, dest, isGadget);
+        break;
+    case QJsonValue::Object: {
+        if (kernel.kind == PropertyKernel::SharedGadget) {
+            deserializeSharedGadget(value, kernel.sharedGadget, metaProp, dest, isGadget);
+            break;
+        }
+
+        if (kernel.kind == PropertyKernel::Dictionary) {
+            deserializeDictionary(value.toObject(), kernel.dictionary, metaProp, dest, isGadget);
+            break;
+        }
+
+        // Only pointers can receive a new instance: a JSON object cannot be assigned to
+        // a scalar, and gadgets held by value need a shared gadget kernel.
+        QMetaType metaType(typeId);
+        bool createGadget = metaType.flags().testFlag(QMetaType::PointerToGadget);
+        if (!createGadget && !metaType.flags().testFlag(QMetaType::PointerToQObject)) {
+            reportError(Error::UnknownType, metaProp.name(), metaProp.enclosingMetaObject());
+            break;
+        }
+
+        QObject* parent = !createGadget && !isGadget ? reinterpret_cast<QObject*>(dest) : nullptr;
+        void* obj = instantiateObject(value, metaType, createGadget, parent);
+        if (!obj)
+            break;
+
+        QVariant value_;
+        if (createGadget)
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+            value_ = QVariant(metaType, &obj);
+#else
+            value_ = QVariant(typeId, &obj);
+#endif
+        else
+            value_ = QVariant::fromValue<QObject*>(reinterpret_cast<QObject*>(obj));
+        writeProp(metaProp, dest, value_, isGadget);
+        break;
+    }
+    }
+}
+
+template<class T>
+void Deserializer<T>::deserializeSharedGadget(const QJsonValue& value,
+                                              const SharedGadgetKernel& kernel,
+                                              const QMetaProperty& metaProp,
+                                              void* dest,
+                                              bool isGadget)
+{
+    quint64 hash = 0;
+    if (kernel.deduplicate) {
+        hash = hash_json(value);
+        const QVector<SharedInstance> candidates = m_sharedInstances.value(hash);
+        for (const SharedInstance& candidate : candidates)
+            if (candidate.json == value) {
+                writeProp(metaProp, dest, candidate.instance, isGadget);
+                return;
+            }
+    }
+
+    void* gadget = instantiateObject(value, QMetaType(kernel.gadgetPointerType), true, nullptr);
+    if (!gadget)
+        return;
+
+    SharedInstance shared;
+    shared.json = value;
+    shared.instance = kernel.wrap(gadget);
+    if (kernel.deduplicate)
+        m_sharedInstances[hash].append(shared);
+    writeProp(metaProp, dest, shared.instance, isGadget);
+}
+
+template<class T>
+void Deserializer<T>::deserializeDictionary(const QJsonObject& object,
+                                            const DictionaryKernel& kernel,
+                                            const QMetaProperty& metaProp,
+                                            void* dest,
+                                            bool isGadget)
 {
-    QVariant v = deserialize_array<T*>(array, [this] (const QJsonValue& jsonValue) -> T* {
-        // TODO: Mem management.
-        T* t = new T();
-        deserializeJson(jsonValue.toObject(), t, &T::staticMetaObject);
-        return t;
+    const DictionaryKernel::Kind kind = kernel.kind;
+    const QMetaType valueType(kernel.valueType);
+    QObject* parent = !isGadget ? reinterpret_cast<QObject*>(dest) : nullptr;
+    const QVariant dictionary = kernel.build(object, [this, kind, &valueType, parent]
+                                             (const QString& key, void* element, const QJsonValue& value) {
+        if (interrupted() || value.isNull())
+            return;
+
+        PathGuard pathGuard(m_path, &key);
+        if (kind == DictionaryKernel::Gadget)
+            deserializeJson(value.toObject(), element, valueType.metaObject());
+        else
+            *reinterpret_cast<void**>(element) = instantiateObject(value, valueType, false, parent);
     });
-    return v.value<QList<T*>>();
+    writeProp(metaProp, dest, dictionary, isGadget);
+}
+
+///
+/// \brief Deserializer<T>::deserializeObjectArray deserializes an array of pointers. On
+/// Qt 6, when the list type is registered with qRegisterMetaType(), elements are appended
+/// through QMetaSequence to the current value, which is then written once through the
+/// property. Otherwise add_<name> is invoked per element. Either way elements are
+/// appended, and elements that cannot be instantiated are kept as nullptr, so indexes
+/// match the JSON.
+///
+template<class T>
+void Deserializer<T>::deserializeObjectArray(const QJsonArray& array,
+                                             const QMetaProperty& metaProp,
+                                             const QString& type,
+                                             void* dest,
+                                             bool isGadget)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    const QMetaType metaType = QMetaType::fromName(type.toLatin1());
+    const bool isPointer = metaType.flags().testFlag(QMetaType::PointerToQObject)
+            || metaType.flags().testFlag(QMetaType::PointerToGadget);
+    QVariant value;
+    if (isPointer && metaProp.isWritable()) {
+        L_INSTR_COUNT(m_instrumentation, metaProp.enclosingMetaObject(), propertyReads);
+        value = isGadget ? metaProp.readOnGadget(dest) : metaProp.read(reinterpret_cast<QObject*>(dest));
+    }
+
+    if (!value.canView<QSequentialIterable>()) {
+        if (isGadget) {
+            reportError(Error::MissingAdder, metaProp.name(), metaProp.enclosingMetaObject());
+            return;
+        }
+
+        addObjectArray(array, metaProp, metaType, reinterpret_cast<QObject*>(dest));
+        return;
+    }
+
+    QSequentialIterable iterable = value.view<QSequentialIterable>();
+    const QMetaSequence sequence = iterable.metaContainer();
+    void* container = iterable.mutableIterable();
+    if (!sequence.canAddValueAtEnd()) {
+        reportError(Error::WriteFailed, metaProp.name(), metaProp.enclosingMetaObject());
+        return;
+    }
+
+    const bool createGadget = metaType.flags().testFlag(QMetaType::PointerToGadget);
+    QObject* parent = !createGadget && !isGadget ? reinterpret_cast<QObject*>(dest) : nullptr;
+    QList<void*> created;
+    int index = 0;
+    QJsonArray::const_iterator it = array.constBegin();
+    for (; it != array.constEnd(); ++it, ++index) {
+        if (interrupted()) {
+            // Objects without a parent are not owned by anything yet.
+            for (void* obj : created) {
+                if (createGadget)
+                    destroy_gadget(obj, metaType.metaObject());
+                else if (!parent)
+                    delete reinterpret_cast<QObject*>(obj);
+            }
+            return;
+        }
+
+        PathGuard pathGuard(m_path, index);
+        void* obj = nullptr;
+        if ((*it).type() != QJsonValue::Null && (*it).type() != QJsonValue::Undefined) {
+            obj = instantiateObject((*it).toObject(), metaType, createGadget, parent);
+            if (obj)
+                created.append(obj);
+        }
+
+        // The element type is a pointer: obj is its value.
+        sequence.addValueAtEnd(container, &obj);
+    }
+
+    writeProp(metaProp, dest, value, isGadget);
+#else
+    // Qt 5 has no mutable view of sequential containers: elements go through the adder.
+    if (isGadget) {
+        reportError(Error::MissingAdder, metaProp.name(), metaProp.enclosingMetaObject());
+        return;
+    }
+
+    addObjectArray(array, metaProp, QMetaType(QMetaType::type(type.toLatin1())), reinterpret_cast<QObject*>(dest));
+#endif
+}
+
+template<class T>
+void Deserializer<T>::addObjectArray(const QJsonArray& array,
+                                     const QMetaProperty& metaProp,
+                                     const QMetaType& metaType,
+                                     QObject* dest)
+{
+    const QByteArray signature = QByteArrayLiteral("add_") + metaProp.name() + QByteArrayLiteral("(void*)");
+    const QMetaMethod addMethod = dest->metaObject()->method(dest->metaObject()->indexOfMethod(signature));
+    if (!addMethod.isValid()) {
+        reportError(Error::MissingAdder, metaProp.name(), dest->metaObject());
+        return;
+    }
+
+    const bool createGadget = metaType.flags().testFlag(QMetaType::PointerToGadget);
+    QObject* parent = !createGadget ? dest : nullptr;
+    int index = 0;
+    QJsonArray::const_iterator it = array.constBegin();
+    for (; it != array.constEnd(); ++it, ++index) {
+        if (interrupted())
+            return;
+
+        PathGuard pathGuard(m_path, index);
+        void* obj = nullptr;
+        if ((*it).type() != QJsonValue::Null && (*it).type() != QJsonValue::Undefined) {
+            // A failed element is added as nullptr, so indexes match the JSON.
+            obj = instantiateObject((*it).toObject(), metaType, createGadget, parent);
+        }
+
+        L_INSTR_COUNT(m_instrumentation, dest->metaObject(), methodInvocations);
+        if (!addMethod.invoke(dest, Qt::DirectConnection, Q_ARG(void*, obj)))
+            reportError(Error::AdderFailed, metaProp.name(), dest->metaObject());
+    }
+}
+
+template<class T>
+bool Deserializer<T>::interrupted()
+{
+    if (!m_aborted && m_interruptCheck && m_interruptCheck()) {
+        m_aborted = true;
+        m_interrupted = true;
+    }
+    return m_aborted;
+}
+
+///
+/// \brief Deserializer<T>::endCall releases what is only needed while a document is
+/// deserialized, like the JSON and the instances kept to share gadgets.
+///
+template<class T>
+void Deserializer<T>::endCall()
+{
+    m_sharedInstances.clear();
+    m_sharedInstances.squeeze();
+}
+
+template<class T>
+void Deserializer<T>::beginCall()
+{
+    m_aborted = false;
+    m_interrupted = false;
+    m_path.clear();
+    m_errors.clear();
+    m_errorCount = 0;
+    m_sharedInstances.clear();
+    m_limitScanner.reset(m_limits);
+    m_inputBytes = 0;
+    m_memoryReport.clear();
+    flushNotifications();
+}
+
+///
+/// \brief Deserializer<T>::checkInput accounts size bytes of input and scans their
+/// structure before they are parsed. Chunks of the same document are scanned as a
+/// whole. Returns the name of the exceeded limit, or nullptr.
+///
+template<class T>
+const char* Deserializer<T>::checkInput(const char* data, qsizetype size)
+{
+    const char* limit = nullptr;
+    m_inputBytes += size;
+    if (m_limits.maxInputBytes >= 0 && m_inputBytes > m_limits.maxInputBytes)
+        limit = "maxInputBytes";
+    else
+        limit = m_limitScanner.feed(data, size);
+
+    if (limit)
+        exceedLimit(limit, &T::staticMetaObject);
+    return limit;
+}
+
+template<class T>
+void Deserializer<T>::exceedLimit(const char* limit, const QMetaObject* metaObject)
+{
+    reportError(Error::LimitExceeded, limit, metaObject);
+    m_aborted = true;
+}
+
+///
+/// \brief Deserializer<T>::measureMemory adds the memory retained by an object returned
+/// to the caller to the report, as measured by memoryUsage().
+///
+template<class T>
+void Deserializer<T>::measureMemory(T* object)
+{
+    if (m_memoryAccounting && object)
+        m_memoryReport += memoryUsage(object);
+}
+
+template<class T>
+T* Deserializer<T>::deserializeRoot(const QJsonObject& json)
+{
+    T* t = instantiateRoot(json);
+    flushNotifications();
+    if (m_aborted) {
+        delete t;
+        return nullptr;
+    }
+
+    measureMemory(t);
+    return t;
+}
+
+///
+/// \brief Deserializer<T>::instantiateRoot creates and fills an instance of T, or of the
+/// subtype selected by the discriminator of json when T is polymorphic. Returns nullptr
+/// if the discriminator is unknown.
+///
+template<class T>
+T* Deserializer<T>::instantiateRoot(const QJsonObject& json)
+{
+    const QMetaObject* metaObject = &T::staticMetaObject;
+    if (!plan(metaObject).subtypes.isEmpty()) {
+        metaObject = concreteType(json, metaObject);
+        if (!metaObject)
+            return nullptr;
+    }
+
+    L_INSTR_COUNT(m_instrumentation, metaObject, instantiations);
+    T* t = new_instance<T>(metaObject, std::is_base_of<QObject, T>());
+    if (!t) {
+        reportError(Error::UnknownType, nullptr, metaObject);
+        return nullptr;
+    }
+
+    deserializeJson(json, t, metaObject);
+    return t;
 }
 
+///
+/// \brief Deserializer<T>::reportError records an error. Errors are stored up to the
+/// limit set with setMaxErrors(), and logged only if enabled. In strict mode the first
+/// error aborts the deserialization.
+///
 template<class T>
-void Deserializer<T>::deserializeJson(QJsonObject json, void* dest, const QMetaObject* metaObject)
+void Deserializer<T>::reportError(Error::Code code, const char* property, const QMetaObject* metaObject)
 {
-    bool isGadget = !metaObject->inherits(&QObject::staticMetaObject);
-    QJsonObject::const_iterator it = json.constBegin();
-    while (it != json.constEnd()) {
-        const QString& key = it.key();
-        for (int i = 0; i < metaObject->propertyCount(); i++)
-            if (metaObject->property(i).name() == key) {
-                deserializeValue(it.value(), metaObject->property(i), dest, isGadget, metaObject);
-                break;
-            }
-        ++it;
+    if (m_statsCollector && metaObject)
+        m_statsCollector->recordWarning(metaObject);
+
+    m_errorCount++;
+    const bool store = m_maxErrors < 0 || m_errors.size() < m_maxErrors;
+    const bool log = m_logLimiter.isEnabled() && m_logLimiter.acquire();
+    if (store || log) {
+        Error error;
+        error.code = code;
+        error.path = path_to_string(m_path);
+        error.property = QString::fromLatin1(property);
+        if (log)
+            qCWarning(lserializer).noquote() << error.toString();
+        if (store)
+            m_errors.append(error);
     }
+
+    if (m_strict)
+        m_aborted = true;
 }
 
 template<class T>
-void Deserializer<T>::deserializeArray(const QJsonArray& array, const QMetaProperty& metaProp, void* dest)
+void Deserializer<T>::writeProp(const QMetaProperty& metaProp, void* dest, const QVariant& value, bool isGadget)
 {
-#ifdef DEBUG_LQOBJECTSERIALIZER
-    qDebug() << "Deserialize array:" << metaProp.typeName() << metaProp.name();
-#endif
-    QString container;
-    QString type;
-    if (metaProp.typeName() == QStringLiteral("QStringList")) {
-        container = QStringLiteral("QList");
-        type = QStringLiteral("QString");
+    if (!metaProp.isWritable()) {
+        reportError(Error::ReadOnlyProperty, metaProp.name(), metaProp.enclosingMetaObject());
+        return;
     }
+
+    L_INSTR_COUNT(m_instrumentation, metaProp.enclosingMetaObject(), variantConstructions);
+    L_INSTR_COUNT(m_instrumentation, metaProp.enclosingMetaObject(), propertyWrites);
+    bool success;
+    if (isGadget)
+        success = metaProp.writeOnGadget(dest, value);
     else {
-        QRegularExpressionMatch match = m_arrayTypeRegex.match(metaProp.typeName());
-        if (!match.hasMatch()) {
-            qWarning() << "Failed to deserialize array with type:" << metaProp.typeName();
-            return;
-        }
+        if (m_notificationMode != ImmediateNotifications)
+            quiet(reinterpret_cast<QObject*>(dest), metaProp.propertyIndex());
+        success = metaProp.write(reinterpret_cast<QObject*>(dest), value);
+    }
 
-        container = match.captured(1);
-        type = match.captured(2);
+    if (!success)
+        reportError(Error::WriteFailed, metaProp.name(), metaProp.enclosingMetaObject());
+}
+
+///
+/// \brief Deserializer<T>::quiet blocks the signals of object until flushNotifications()
+/// and records the property that is about to be written.
+///
+template<class T>
+void Deserializer<T>::quiet(QObject* object, int propertyIndex)
+{
+    typename QHash<QObject*, int>::const_iterator it = m_quietIndex.constFind(object);
+    int index;
+    if (it == m_quietIndex.constEnd()) {
+        QuietObject quietObject;
+        quietObject.object = object;
+        quietObject.wasBlocked = object->blockSignals(true);
+        index = m_quietObjects.size();
+        m_quietObjects.append(quietObject);
+        m_quietIndex.insert(object, index);
     }
+    else
+        index = it.value();
 
-    if (type == QStringLiteral("int"))
-        writeProp(metaProp, dest, deserialize_array<int>(array, [] (const QJsonValue& jsonValue) -> int {
-            return jsonValue.toInt();
-        }), false);
-    else if (type == QStringLiteral("long"))
-        writeProp(metaProp, dest, deserialize_array<long>(array, [] (const QJsonValue& jsonValue) -> long {
-            return jsonValue.toInt();
-        }), false);
-    else if (type == QStringLiteral("float"))
-        writeProp(metaProp, dest, deserialize_array<float>(array, [] (const QJsonValue& jsonValue) -> float {
-            return jsonValue.toDouble();
-        }), false);
-    else if (type == QStringLiteral("double"))
-        writeProp(metaProp, dest, deserialize_array<double>(array, [] (const QJsonValue& jsonValue) -> double {
-            return jsonValue.toDouble();
-        }), false);
-    else if (type == QStringLiteral("QString"))
-        writeProp(metaProp, dest, deserialize_array<QString>(array, [] (const QJsonValue& jsonValue) -> QString {
-            return jsonValue.toString();
-        }), false);
-    else if (type == QStringLiteral("bool"))
-        writeProp(metaProp, dest, deserialize_array<bool>(array, [] (const QJsonValue& jsonValue) -> bool {
-            return jsonValue.toBool();
-        }), false);
-    else {
-        // TODO: Implement gadget.
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-        if (QMetaType::fromName(type.toLatin1()).id() != QMetaType::UnknownType)
-#else
-        if (QMetaType::type(type.toLatin1().data()) != QMetaType::UnknownType)
-#endif
-            deserializeObjectArray(array, metaProp.name(), type, reinterpret_cast<QObject*>(dest));
+    QVector<int>& properties = m_quietObjects[index].properties;
+    if (!properties.contains(propertyIndex))
+        properties.append(propertyIndex);
+}
+
+template<class T>
+void Deserializer<T>::flushNotifications()
+{
+    if (m_quietObjects.isEmpty() && m_pendingParents.isEmpty())
+        return;
+
+    // Children are parented once the tree is complete, so that ChildAdded events are
+    // not delivered while it is populated. Children of objects deleted in the meantime
+    // were owned by them and are deleted as well.
+    const QVector<PendingParent> pendingParents = m_pendingParents;
+    m_pendingParents.clear();
+    for (const PendingParent& pendingParent : pendingParents) {
+        if (!pendingParent.child)
+            continue;
+        if (pendingParent.parent)
+            pendingParent.child->setParent(pendingParent.parent);
         else
-            qWarning() << type << "is not known";
+            delete pendingParent.child;
     }
 
-    return;
+    const QVector<QuietObject> objects = m_quietObjects;
+    m_quietObjects.clear();
+    m_quietIndex.clear();
+    for (const QuietObject& quietObject : objects)
+        if (quietObject.object)
+            quietObject.object->blockSignals(quietObject.wasBlocked);
+
+    if (m_notificationMode != CoalescedNotifications)
+        return;
+
+    for (const QuietObject& quietObject : objects) {
+        QObject* object = quietObject.object;
+        if (!object || quietObject.wasBlocked)
+            continue;
+
+        const QMetaObject* metaObj = object->metaObject();
+        QVector<int> emitted;
+        for (int propertyIndex : quietObject.properties) {
+            const QMetaProperty metaProp = metaObj->property(propertyIndex);
+            if (!metaProp.hasNotifySignal())
+                continue;
+
+            const QMetaMethod signal = metaProp.notifySignal();
+            if (emitted.contains(signal.methodIndex()))
+                continue;
+            emitted.append(signal.methodIndex());
+
+            // Signals carrying the new value receive the value read back from the property.
+            if (signal.parameterCount() == 0) {
+                void* argv[] = { nullptr };
+                QMetaObject::activate(object, signal.enclosingMetaObject(),
+                                      signal.methodIndex() - signal.enclosingMetaObject()->methodOffset(), argv);
+            }
+            else
+                emit_notify_signal(object, signal, metaProp.read(object));
+        }
+    }
 }
 
+///
+/// \brief Deserializer<T>::treeReplaced calls the handler set with
+/// setTreeReplacedHandler() once the tree of object was populated and its
+/// notifications flushed.
+///
 template<class T>
-void* Deserializer<T>::instantiateObject(const QJsonValue& value, const QMetaType& metaType, bool isGadget, QObject* parent)
+void Deserializer<T>::treeReplaced(T* object)
 {
-    const QMetaObject* metaObject = metaType.metaObject();
-    if (metaType.id() == QMetaType::UnknownType) {
-        qCDebug(lserializer) << "Class not registered:"
-                             << metaType.name() << metaObject->className();
-        return nullptr;
-    }
+    if (m_treeReplacedHandler)
+        m_treeReplacedHandler(object);
+}
 
-    if (!isGadget) {
-        QObject* child = metaObject->newInstance();
-        if (parent)
-            child->setParent(parent);
-        deserializeJson(value.toObject(), child, metaObject);
-        return child;
+/// \brief The IncrementalDeserializer class deserializes a JSON object fed in chunks,
+/// e.g. on each readyRead of a socket. Each member of the root object is deserialized
+/// as soon as its last byte is received, so the object is complete shortly after the
+/// last chunk. Members are the unit of progress: a document with a single large member
+/// is scanned while it arrives but parsed only when the member is complete. Use
+/// ObjectListModelFeeder to consume the elements of a root array one by one.
+///
+template<class T>
+class IncrementalDeserializer : public Deserializer<T>
+{
+public:
+    IncrementalDeserializer(const MemberStringifiersMap& memberStringifiers = MemberStringifiersMap(),
+                            const TypeStringifiersMap& typeStringifiers = TypeStringifiersMap());
+    ~IncrementalDeserializer();
+
+    bool feed(LByteArrayView data);
+    bool isFinished() const { return m_finished; }
+    bool hasError() const { return !m_errorString.isEmpty(); }
+    QString errorString() const { return m_errorString; }
+    T* object() const { return m_object; }
+    T* takeObject();
+    void reset();
+    void setCodec(const QSharedPointer<Codec>& codec) { m_codec = codec; }
+
+private:
+    Q_DISABLE_COPY(IncrementalDeserializer)
+    bool scan();
+    bool fail(const QString& errorString);
+
+private:
+    JsonScanner m_scanner;
+    QSharedPointer<Codec> m_codec;
+    T* m_object;
+    bool m_finished;
+    QString m_errorString;
+};
+
+template<class T>
+IncrementalDeserializer<T>::IncrementalDeserializer(const MemberStringifiersMap& memberStringifiers,
+                                                    const TypeStringifiersMap& typeStringifiers) :
+    Deserializer<T>(memberStringifiers, typeStringifiers)
+  , m_object(nullptr)
+  , m_finished(false) {}
+
+template<class T>
+IncrementalDeserializer<T>::~IncrementalDeserializer()
+{
+    delete m_object;
+}
+
+///
+/// \brief IncrementalDeserializer::feed scans the next chunk of the document. When a
+/// codec is set, data is decoded first, so compressed input is never expanded as a
+/// whole.
+///
+template<class T>
+bool IncrementalDeserializer<T>::feed(LByteArrayView data)
+{
+    if (hasError())
+        return false;
+
+    if (m_codec) {
+        QByteArray decoded;
+        if (!m_codec->process(data.data(), data.size(), &decoded))
+            return fail(m_codec->errorString());
+        if (const char* limit = this->checkInput(decoded.constData(), decoded.size()))
+            return fail(QStringLiteral("%1 exceeded").arg(QLatin1String(limit)));
+        m_scanner.feed(decoded.constData(), decoded.size());
     }
     else {
-        // TODO: mem?
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-        void* gadget = QMetaType::fromName(metaObject->className()).create(nullptr);
-#else
-        void* gadget = QMetaType::create(QMetaType::type(metaObject->className()));
-#endif
-        deserializeJson(value.toObject(), gadget, metaObject);
-        return gadget;
+        if (const char* limit = this->checkInput(data.data(), data.size()))
+            return fail(QStringLiteral("%1 exceeded").arg(QLatin1String(limit)));
+        m_scanner.feed(data.data(), data.size());
     }
 
-    return nullptr;
+    const bool wasFinished = m_finished;
+    const bool ret = scan();
+    this->flushNotifications();
+    if (m_finished && !wasFinished && !hasError())
+        this->treeReplaced(m_object);
+    return ret;
 }
 
 template<class T>
-QVariant Deserializer<T>::destringify(const QString& value,
-                                      const QMetaProperty& metaProp,
-                                      const QMetaObject* metaObject)
+bool IncrementalDeserializer<T>::scan()
 {
-    Stringifier* strigifier = find_stringifier(metaObject,
-                                               metaProp.name(),
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-                                               metaProp.metaType(),
-#else
-                                               QMetaType(QMetaType::type(metaProp.typeName())),
-#endif
+    while (true) {
+        switch (m_scanner.next()) {
+        case JsonScanner::NeedMoreData:
+            return true;
+        case JsonScanner::Finished:
+            if (!m_object)
+                m_object = new T;
+            m_finished = true;
+            this->endCall();
+            this->measureMemory(m_object);
+            return true;
+        case JsonScanner::Error:
+            return fail(m_scanner.errorString());
+        case JsonScanner::Value: {
+            if (m_scanner.isRootArray())
+                return fail(QStringLiteral("Root must be an object"));
+            if (!m_object)
+                m_object = new T;
+
+            const QByteArray key = m_scanner.key();
+            const QByteArray value = m_scanner.value();
+            const QMetaObject* metaObject = &T::staticMetaObject;
+            const bool isGadget = !metaObject->inherits(&QObject::staticMetaObject);
+
+            // Raw JSON members are stored as they are, without parsing, and QByteArray
+            // members receive the UTF-8 of the string without building a QString.
+            if (!key.contains('\\')) {
+                const int propIndex = metaObject->indexOfProperty(key.mid(1, key.size() - 2).constData());
+                if (propIndex >= 0 && metaObject->property(propIndex).userType() == qMetaTypeId<RawJson>()) {
+                    this->writeProp(metaObject->property(propIndex), m_object,
+                                    QVariant::fromValue(RawJson::fromJson(value)), isGadget);
+                    break;
+                }
+                if (propIndex >= 0 && this->deserializeUtf8(value, metaObject->property(propIndex), m_object, isGadget))
+                    break;
+            }
 
-                                               m_memberStringifiers,
-                                               m_typeStringifiers);
-    if (!strigifier)
-        return QVariant();
+            QByteArray member;
+            member.reserve(key.size() + value.size() + 3);
+            member.append('{').append(key).append(':').append(value).append('}');
 
-    return strigifier->destringify(value);
+            QJsonParseError error;
+            const QJsonObject json = QJsonDocument::fromJson(member, &error).object();
+            if (error.error != QJsonParseError::NoError)
+                return fail(error.errorString());
+
+            this->deserializeMember(json.constBegin().key(), json.constBegin().value(), m_object, isGadget, metaObject);
+            if (this->interrupted())
+                return fail(QStringLiteral("Deserialization aborted"));
+            break;
+        }
+        }
+    }
 }
 
 template<class T>
-void Deserializer<T>::deserializeValue(const QJsonValue& value,
-                                        const QMetaProperty& metaProp,
-                                        void* dest,
-                                        bool isGadget,
-                                        const QMetaObject* metaObject)
+T* IncrementalDeserializer<T>::takeObject()
 {
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-    int typeId = metaProp.metaType().id();
-#else
-    int typeId = QMetaType::type(metaProp.typeName());
-#endif
+    T* ret = m_object;
+    m_object = nullptr;
+    return ret;
+}
 
-    switch (typeId) {
-    case QMetaType::QVariant:
-        writeProp(metaProp, dest, value.toVariant(), isGadget);
-        return;
-    case QMetaType::QVariantHash:
-        writeProp(metaProp, dest, value.toVariant().toHash(), isGadget);
-        return;
-    case QMetaType::QVariantMap:
-        writeProp(metaProp, dest, value.toVariant().toMap(), isGadget);
-        return;
-    case QMetaType::QVariantList:
-        writeProp(metaProp, dest, value.toVariant().toList(), isGadget);
-        return;
-    default:
-        break;
-    }
+template<class T>
+void IncrementalDeserializer<T>::reset()
+{
+    delete m_object;
+    m_object = nullptr;
+    m_finished = false;
+    m_errorString.clear();
+    m_scanner.reset();
+    if (m_codec)
+        m_codec->reset();
+    this->beginCall();
+}
 
-    switch (value.type()) {
-    case QJsonValue::Null:
-    case QJsonValue::Undefined:
-        writeProp(metaProp, dest, QVariant(), isGadget);
-        break;
-    case QJsonValue::Bool:
-        writeProp(metaProp, dest, value.toBool(), isGadget);
-        break;
-    case QJsonValue::Double:
-        writeProp(metaProp, dest, value.toDouble(), isGadget);
-        break;
-    case QJsonValue::String: {
-        const QVariant destringified = destringify(value.toString(), metaProp, metaObject);
-        if (!destringified.isNull())
-            writeProp(metaProp, dest, destringified, isGadget);
-        else
-            writeProp(metaProp, dest, value.toString(), isGadget);
-        break;
-    }
-    case QJsonValue::Array:
-        deserializeArray(value.toArray(), metaProp, dest);
-        break;
-    case QJsonValue::Object:
-        QMetaType metaType(typeId);
-        bool createGadget = metaType.flags().testFlag(QMetaType::PointerToGadget);
-        // TODO: Check error.
-        QObject* parent = !createGadget && !isGadget ? reinterpret_cast<QObject*>(dest) : nullptr;
-        void* obj = instantiateObject(value, metaType, createGadget, parent);
-        QVariant value_;
-        if (createGadget)
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-            value_ = QVariant(metaType, &obj);
-#else
-            value_ = QVariant(typeId, &obj);
-#endif
-        else
-            value_ = QVariant::fromValue<QObject*>(reinterpret_cast<QObject*>(obj));
-        writeProp(metaProp, dest, value_, isGadget);
+template<class T>
+bool IncrementalDeserializer<T>::fail(const QString& errorString)
+{
+    m_errorString = errorString;
+    this->endCall();
+    return false;
+}
+
+///
+/// \brief The ObjectListModelFeeder class deserializes a JSON array fed in chunks and
+/// appends the objects to an ObjectListModel in batches, so that rows are shown as
+/// soon as they are received. Batches are at most batchSize objects; a partial batch
+/// is appended at the end of each feed().
+///
+template<class T>
+class ObjectListModelFeeder : public Deserializer<T>
+{
+    static_assert(std::is_base_of<QObject, T>::value, "T must be a QObject");
+public:
+    ObjectListModelFeeder(ObjectListModel* model,
+                          int batchSize = 50,
+                          const MemberStringifiersMap& memberStringifiers = MemberStringifiersMap(),
+                          const TypeStringifiersMap& typeStringifiers = TypeStringifiersMap());
+    ~ObjectListModelFeeder();
+
+    bool feed(LByteArrayView data);
+    void flush();
+    bool isFinished() const { return m_finished; }
+    bool hasError() const { return !m_errorString.isEmpty(); }
+    QString errorString() const { return m_errorString; }
+    void setBatchSize(int batchSize) { m_batchSize = batchSize; }
+    int batchSize() const { return m_batchSize; }
+    void reset();
 
-        // TODO: Handle errors.
+private:
+    Q_DISABLE_COPY(ObjectListModelFeeder)
+    bool fail(const QString& errorString);
 
-        break;
-    }
+private:
+    JsonScanner m_scanner;
+    QPointer<ObjectListModel> m_model;
+    QList<QObject*> m_batch;
+    int m_batchSize;
+    int m_index;
+    bool m_finished;
+    QString m_errorString;
+};
+
+template<class T>
+ObjectListModelFeeder<T>::ObjectListModelFeeder(ObjectListModel* model,
+                                                int batchSize,
+                                                const MemberStringifiersMap& memberStringifiers,
+                                                const TypeStringifiersMap& typeStringifiers) :
+    Deserializer<T>(memberStringifiers, typeStringifiers)
+  , m_model(model)
+  , m_batchSize(batchSize)
+  , m_index(0)
+  , m_finished(false) {}
+
+template<class T>
+ObjectListModelFeeder<T>::~ObjectListModelFeeder()
+{
+    qDeleteAll(m_batch);
 }
 
 template<class T>
-void Deserializer<T>::deserializeObjectArray(const QJsonArray& array, const QString& propName, const QString& type, QObject* dest)
+bool ObjectListModelFeeder<T>::feed(LByteArrayView data)
 {
-    QMetaMethod addMethod;
-    for (int i = 0; i < dest->metaObject()->methodCount(); i++)
-        if (dest->metaObject()->method(i).name() == QString("add_%1").arg(propName))
-            addMethod = dest->metaObject()->method(i);
-    if (!addMethod.isValid()) {
-        qWarning() << "Could not find add method";
-        return;
-    }
+    if (hasError())
+        return false;
+    if (const char* limit = this->checkInput(data.data(), data.size()))
+        return fail(QStringLiteral("%1 exceeded").arg(QLatin1String(limit)));
+
+    m_scanner.feed(data.data(), data.size());
+    while (true) {
+        switch (m_scanner.next()) {
+        case JsonScanner::NeedMoreData:
+            // Rows are not held back waiting for a slow sender.
+            flush();
+            return true;
+        case JsonScanner::Finished:
+            flush();
+            m_finished = true;
+            this->endCall();
+            return true;
+        case JsonScanner::Error:
+            return fail(m_scanner.errorString());
+        case JsonScanner::Value: {
+            if (!m_scanner.isRootArray())
+                return fail(QStringLiteral("Root must be an array"));
+
+            PathGuard pathGuard(this->m_path, m_index++);
+            const QByteArray value = m_scanner.value();
+            if (value == "null")
+                break;
 
-    QJsonArray::const_iterator it = array.constBegin();
-    while (it != array.constEnd()) {
-        if ((*it).type() == QJsonValue::Null || (*it).type() == QJsonValue::Undefined) {
-            if (!addMethod.invoke(dest, Qt::DirectConnection, Q_ARG(void*, nullptr)))
-                qWarning(lserializer) << "Failed to invoke add method";
-        }
-        else {
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-            QMetaType metaType = QMetaType::fromName(type.toLatin1());
-#else
-            int typeId = QMetaType::type(type.toLatin1());
-            QMetaType metaType(typeId);
-#endif
-            const bool createGadget = metaType.flags().testFlag(QMetaType::PointerToGadget);
-            QObject* parent = !createGadget ? reinterpret_cast<QObject*>(dest) : nullptr;
-            void* obj = instantiateObject((*it).toObject(), metaType, createGadget, parent);
-            if (!obj)
-                continue;
+            QJsonParseError error;
+            const QJsonDocument doc = QJsonDocument::fromJson(value, &error);
+            if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+                this->reportError(Error::TypeMismatch, nullptr, &T::staticMetaObject);
+                break;
+            }
 
-            if (!addMethod.invoke(dest, Qt::DirectConnection, Q_ARG(void*, obj)))
-                qWarning(lserializer) << "Failed to invoke add method";
-        }
+            T* t = this->deserializeRoot(doc.object());
+            if (!t && this->interrupted())
+                return fail(QStringLiteral("Deserialization aborted"));
+            if (!t)
+                break;
 
-        ++it;
+            m_batch.append(t);
+            if (m_batch.size() >= m_batchSize)
+                flush();
+            break;
+        }
+        }
     }
 }
 
 template<class T>
-void Deserializer<T>::writeProp(const QMetaProperty& metaProp, void* dest, const QVariant& value, bool isGadget)
+void ObjectListModelFeeder<T>::flush()
 {
-    if (!metaProp.isWritable()) {
-        qCWarning(lserializer) << "Prop"
-                               << metaProp.name()
-                               << "must be writable to deserialize";
+    if (m_batch.isEmpty())
         return;
-    }
 
-    bool success;
-    if (isGadget)
-        success = metaProp.writeOnGadget(dest, value);
+    this->flushNotifications();
+    if (m_model)
+        m_model->append(m_batch);
     else
-        success = metaProp.write(reinterpret_cast<QObject*>(dest), value);
+        qDeleteAll(m_batch);
+    m_batch.clear();
+}
 
-    if (!success)
-        qCWarning(lserializer) << "Failed to write" << value
-                               << "to" << metaProp.name();
+template<class T>
+void ObjectListModelFeeder<T>::reset()
+{
+    qDeleteAll(m_batch);
+    m_batch.clear();
+    m_index = 0;
+    m_finished = false;
+    m_errorString.clear();
+    m_scanner.reset();
+    this->beginCall();
+}
+
+template<class T>
+bool ObjectListModelFeeder<T>::fail(const QString& errorString)
+{
+    m_errorString = errorString;
+    this->endCall();
+    return false;
 }
 
 } // namespace lqo
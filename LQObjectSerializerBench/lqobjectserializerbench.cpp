@@ -0,0 +1,648 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2020 Luca Carlon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QJsonDocument>
+#include <QFile>
+#include <QTextStream>
+#include <QtMath>
+
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+#include "../LQObjectSerializer/lserializer.h"
+#include "../deps/lqtutils/lqtutils_qsl.h"
+
+#ifdef INSTRUMENT_LQOBJECTSERIALIZER
+// Allocations are counted by hooking the allocator of the whole process, so that
+// allocations made inside Qt are also visible.
+static std::atomic<quint64> s_allocations(0);
+
+static quint64 allocation_count()
+{
+    return s_allocations.load(std::memory_order_relaxed);
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+
+void* malloc(size_t size) noexcept
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) noexcept
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(p, size);
+}
+}
+#else
+// Only allocations through operator new are visible here.
+void* operator new(std::size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+#endif
+#endif // INSTRUMENT_LQOBJECTSERIALIZER
+
+// Models are the same used by the tests, so that numbers can be related to
+// the functional coverage.
+
+L_BEGIN_CLASS(Item)
+L_RW_PROP(QString, id, setId, QString())
+L_RW_PROP(QString, label, setLabel, QString())
+L_END_CLASS
+
+L_BEGIN_CLASS(Menu)
+L_RW_PROP(QString, header, setHeader)
+L_RW_PROP_ARRAY_WITH_ADDER(Item*, items, setItems)
+L_END_CLASS
+
+L_BEGIN_CLASS(MenuRoot)
+L_RW_PROP(Menu*, menu, setMenu, nullptr)
+L_END_CLASS
+
+L_BEGIN_CLASS(GlossDefObj)
+L_RW_PROP(QString, para, setPara, QString())
+L_RW_PROP(QList<QString>, GlossSeeAlso, setGlossSeeAlso)
+L_END_CLASS
+
+L_BEGIN_CLASS(GlossEntryObj)
+L_RW_PROP(QString, ID, setID)
+L_RW_PROP(QString, SortAs, setSortAs)
+L_RW_PROP(QString, GlossTerm, setGlossTerm)
+L_RW_PROP(QString, Acronym, setAcronym)
+L_RW_PROP(QString, Abbrev, setAbbrev)
+L_RW_PROP(QString, GlossSee, setGlossSee)
+L_RW_PROP(GlossDefObj*, GlossDef, setGlossDef, nullptr)
+L_END_CLASS
+
+L_BEGIN_CLASS(GlossListObj)
+L_RW_PROP(GlossEntryObj*, GlossEntry, setGlossEntry, nullptr)
+L_END_CLASS
+
+L_BEGIN_CLASS(GlossDivObj)
+L_RW_PROP(QString, title, setTitle)
+L_RW_PROP(GlossListObj*, GlossList, setGlossList, nullptr)
+L_END_CLASS
+
+L_BEGIN_CLASS(Glossary)
+L_RW_PROP(QString, title, setTitle)
+L_RW_PROP(GlossDivObj*, GlossDiv, setGlossDiv, nullptr)
+L_END_CLASS
+
+L_BEGIN_CLASS(GlossaryRoot)
+L_RW_PROP(Glossary*, glossary, setGlossary, nullptr)
+L_END_CLASS
+
+L_BEGIN_GADGET(KodiResponseItem)
+L_RW_GPROP(QString, fanart, setFanart)
+L_RW_GPROP(QString, label, setLabel)
+L_RW_GPROP(int, id, setId)
+L_RW_GPROP(QString, thumbnail, setThumbnail)
+L_RW_GPROP(QString, title, setTitle)
+L_RW_GPROP(QString, type, setType)
+L_END_GADGET
+
+L_BEGIN_GADGET(KodiResponseResult)
+L_RW_GPROP(KodiResponseItem*, item, setItem, nullptr)
+public:
+    virtual ~KodiResponseResult() {
+        delete m_item;
+    }
+L_END_GADGET
+
+L_BEGIN_GADGET(KodiResponse)
+L_RW_GPROP(int, id, setId)
+L_RW_GPROP(QString, jsonrpc, setJsonrpc)
+L_RW_GPROP(KodiResponseResult*, result, setResult, nullptr)
+public:
+    virtual ~KodiResponse() {
+        delete m_result;
+    }
+L_END_GADGET
+
+L_BEGIN_GADGET(LGHOwner)
+L_RW_GPROP(QString, login, setLogin, "login")
+L_RW_GPROP(int, id, setId, 8)
+L_RW_GPROP(QString, node_id, setNode_id, "node_id")
+L_RW_GPROP(QString, avatar_url, setAvatar_url, "avatar")
+L_END_GADGET
+Q_DECLARE_METATYPE(LGHOwner*)
+
+L_BEGIN_GADGET(LGHRepo)
+L_RW_GPROP(int, id, setId)
+L_RW_GPROP(QString, node_id, setNode_id)
+L_RW_GPROP(QString, name, setName)
+L_RW_GPROP(QString, full_name, setFull_name)
+L_RW_GPROP(LGHOwner*, owner, setOwner)
+public:
+    virtual ~LGHRepo() {
+        delete m_owner;
+    }
+L_END_GADGET
+Q_DECLARE_METATYPE(LGHRepo*)
+
+///
+/// \brief The Payload struct is a generated document, with the number of
+/// model objects it is expected to produce.
+///
+struct Payload
+{
+    QByteArray bytes;
+    qint64 objects = 0;
+};
+
+///
+/// \brief The PayloadGenerator class generates deterministic documents: the same
+/// seed always produces the same bytes.
+///
+class PayloadGenerator
+{
+public:
+    PayloadGenerator(quint32 seed) : m_random(seed) {}
+
+    Payload menu(int items);
+    Payload glossary(int seeAlso);
+    Payload kodiResponse();
+    Payload githubRepos(int count);
+
+private:
+    QString word(int minLength, int maxLength);
+
+private:
+    QRandomGenerator m_random;
+};
+
+QString PayloadGenerator::word(int minLength, int maxLength)
+{
+    const int length = m_random.bounded(minLength, maxLength + 1);
+    QString ret;
+    ret.reserve(length);
+    for (int i = 0; i < length; i++)
+        ret.append(QChar('a' + m_random.bounded(26)));
+    return ret;
+}
+
+Payload PayloadGenerator::menu(int items)
+{
+    Payload ret;
+    QJsonArray array;
+    for (int i = 0; i < items; i++) {
+        // Same shape as json_2.json: some items are null, some have no label.
+        if (m_random.bounded(7) == 0) {
+            array.append(QJsonValue::Null);
+            continue;
+        }
+
+        QJsonObject item;
+        item[QSL("id")] = word(4, 12);
+        if (m_random.bounded(3) != 0)
+            item[QSL("label")] = word(4, 12) + QChar(' ') + word(4, 12);
+        array.append(item);
+        ret.objects++;
+    }
+
+    QJsonObject menu;
+    menu[QSL("header")] = word(8, 16);
+    menu[QSL("items")] = array;
+
+    QJsonObject root;
+    root[QSL("menu")] = menu;
+    ret.objects += 2;
+    ret.bytes = QJsonDocument(root).toJson(QJsonDocument::Compact);
+    return ret;
+}
+
+Payload PayloadGenerator::glossary(int seeAlso)
+{
+    QJsonArray seeAlsoArray;
+    for (int i = 0; i < seeAlso; i++)
+        seeAlsoArray.append(word(3, 8).toUpper());
+
+    QJsonObject def;
+    def[QSL("para")] = word(20, 80);
+    def[QSL("GlossSeeAlso")] = seeAlsoArray;
+
+    QJsonObject entry;
+    entry[QSL("ID")] = word(4, 4).toUpper();
+    entry[QSL("SortAs")] = word(4, 4).toUpper();
+    entry[QSL("GlossTerm")] = word(20, 40);
+    entry[QSL("Acronym")] = word(4, 4).toUpper();
+    entry[QSL("Abbrev")] = word(8, 14);
+    entry[QSL("GlossDef")] = def;
+    entry[QSL("GlossSee")] = word(4, 8);
+
+    QJsonObject list;
+    list[QSL("GlossEntry")] = entry;
+
+    QJsonObject div;
+    div[QSL("title")] = word(1, 1).toUpper();
+    div[QSL("GlossList")] = list;
+
+    QJsonObject glossary;
+    glossary[QSL("title")] = word(8, 16);
+    glossary[QSL("GlossDiv")] = div;
+
+    QJsonObject root;
+    root[QSL("glossary")] = glossary;
+
+    Payload ret;
+    ret.objects = 6;
+    ret.bytes = QJsonDocument(root).toJson(QJsonDocument::Compact);
+    return ret;
+}
+
+Payload PayloadGenerator::kodiResponse()
+{
+    QJsonObject item;
+    item[QSL("fanart")] = QString();
+    item[QSL("id")] = m_random.bounded(1, 100000);
+    item[QSL("label")] = word(3, 12);
+    item[QSL("thumbnail")] = QSL("image:") + word(8, 16);
+    item[QSL("title")] = word(3, 12);
+    item[QSL("type")] = QSL("channel");
+
+    QJsonObject result;
+    result[QSL("item")] = item;
+
+    QJsonObject root;
+    root[QSL("id")] = m_random.bounded(1, 100000);
+    root[QSL("jsonrpc")] = QSL("2.0");
+    root[QSL("result")] = result;
+
+    Payload ret;
+    ret.objects = 3;
+    ret.bytes = QJsonDocument(root).toJson(QJsonDocument::Compact);
+    return ret;
+}
+
+Payload PayloadGenerator::githubRepos(int count)
+{
+    // A handful of owners shared by many repos, as in a real listing.
+    QList<QJsonObject> owners;
+    for (int i = 0; i < 8; i++) {
+        QJsonObject owner;
+        owner[QSL("login")] = word(6, 12);
+        owner[QSL("id")] = m_random.bounded(1, 10000000);
+        owner[QSL("node_id")] = word(20, 20);
+        owner[QSL("avatar_url")] = QSL("https://avatars.githubusercontent.com/u/") + word(8, 8);
+        owners.append(owner);
+    }
+
+    QJsonArray array;
+    for (int i = 0; i < count; i++) {
+        const QJsonObject owner = owners.at(m_random.bounded(owners.size()));
+        const QString name = word(4, 20);
+
+        QJsonObject repo;
+        repo[QSL("id")] = m_random.bounded(1, 100000000);
+        repo[QSL("node_id")] = word(20, 20);
+        repo[QSL("name")] = name;
+        repo[QSL("full_name")] = owner[QSL("login")].toString() + QChar('/') + name;
+        repo[QSL("owner")] = owner;
+        array.append(repo);
+    }
+
+    Payload ret;
+    ret.objects = 2*count;
+    ret.bytes = QJsonDocument(array).toJson(QJsonDocument::Compact);
+    return ret;
+}
+
+///
+/// \brief The BenchResult struct holds the samples of a single benchmark.
+///
+struct BenchResult
+{
+    QString name;
+    qint64 objects = 0;
+    qint64 bytes = 0;
+    QVector<qint64> samples;
+    lqo::Counters counters;
+
+    qint64 percentile(double p) const;
+    qint64 total() const;
+    QJsonObject toJson() const;
+};
+
+qint64 BenchResult::percentile(double p) const
+{
+    if (samples.isEmpty())
+        return 0;
+    QVector<qint64> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    const int index = qBound(0, qCeil(p*sorted.size()) - 1, sorted.size() - 1);
+    return sorted.at(index);
+}
+
+qint64 BenchResult::total() const
+{
+    qint64 ret = 0;
+    for (qint64 sample : samples)
+        ret += sample;
+    return ret;
+}
+
+QJsonObject BenchResult::toJson() const
+{
+    const double seconds = total()/1E9;
+    QJsonObject ret;
+    ret[QSL("name")] = name;
+    ret[QSL("iterations")] = samples.size();
+    ret[QSL("objects")] = objects;
+    ret[QSL("bytes")] = bytes;
+    ret[QSL("meanNs")] = samples.isEmpty() ? 0. : static_cast<double>(total())/samples.size();
+    ret[QSL("p50Ns")] = percentile(0.5);
+    ret[QSL("p99Ns")] = percentile(0.99);
+    ret[QSL("objectsPerSecond")] = seconds > 0 ? objects*samples.size()/seconds : 0.;
+    ret[QSL("mbPerSecond")] = seconds > 0 ? bytes*samples.size()/seconds/(1024*1024) : 0.;
+#ifdef INSTRUMENT_LQOBJECTSERIALIZER
+    QJsonObject countersJson;
+    countersJson[QSL("allocations")] = static_cast<qint64>(counters.allocations);
+    countersJson[QSL("instantiations")] = static_cast<qint64>(counters.instantiations);
+    countersJson[QSL("variantConstructions")] = static_cast<qint64>(counters.variantConstructions);
+    countersJson[QSL("propertyReads")] = static_cast<qint64>(counters.propertyReads);
+    countersJson[QSL("propertyWrites")] = static_cast<qint64>(counters.propertyWrites);
+    countersJson[QSL("methodInvocations")] = static_cast<qint64>(counters.methodInvocations);
+    ret[QSL("counters")] = countersJson;
+#endif
+    return ret;
+}
+
+///
+/// \brief The BenchRunner class runs the benchmarks. Each body runs the measured work
+/// and returns a cleanup function, which is run outside of the measured time.
+///
+class BenchRunner
+{
+public:
+    typedef std::function<std::function<void()>()> Body;
+
+    BenchRunner(int iterations, const QString& filter) :
+        m_iterations(iterations)
+      , m_filter(filter) {}
+
+    void run(const QString& name,
+             const Payload& payload,
+             const Body& body,
+             const lqo::Instrumentation* instrumentation = nullptr);
+    const QList<BenchResult>& results() const { return m_results; }
+
+private:
+    int m_iterations;
+    QString m_filter;
+    QList<BenchResult> m_results;
+};
+
+void BenchRunner::run(const QString& name,
+                      const Payload& payload,
+                      const Body& body,
+                      const lqo::Instrumentation* instrumentation)
+{
+    if (!m_filter.isEmpty() && !name.contains(m_filter))
+        return;
+
+    // Warm up caches and lazy registrations.
+    body()();
+
+    BenchResult result;
+    result.name = name;
+    result.objects = payload.objects;
+    result.bytes = payload.bytes.size();
+    result.samples.reserve(m_iterations);
+
+    QElapsedTimer timer;
+    for (int i = 0; i < m_iterations; i++) {
+        timer.start();
+        std::function<void()> cleanup = body();
+        result.samples.append(timer.nsecsElapsed());
+        cleanup();
+    }
+
+    // Counters of the last measured call.
+    if (instrumentation)
+        result.counters = instrumentation->lastCall().counters;
+
+    const QJsonObject json = result.toJson();
+    QTextStream(stderr) << QString("%1 p50: %2 us p99: %3 us %4 objects/s %5 MB/s")
+                           .arg(name, -40)
+                           .arg(json[QSL("p50Ns")].toDouble()/1000, 10, 'f', 1)
+                           .arg(json[QSL("p99Ns")].toDouble()/1000, 10, 'f', 1)
+                           .arg(json[QSL("objectsPerSecond")].toDouble(), 12, 'f', 0)
+                           .arg(json[QSL("mbPerSecond")].toDouble(), 8, 'f', 2)
+                        << Qt::endl;
+
+    m_results.append(result);
+}
+
+template<class T>
+void bench_qobject(BenchRunner& runner, const QString& name, const Payload& payload)
+{
+    const QByteArray& jsonString = payload.bytes;
+    const QJsonObject json = QJsonDocument::fromJson(payload.bytes).object();
+    lqo::Deserializer<T> deserializer;
+    lqo::Serializer serializer;
+
+    runner.run(QSL("deserialize/%1").arg(name), payload, [&deserializer, &jsonString] () -> std::function<void()> {
+        T* t = deserializer.deserialize(jsonString);
+        return [t] { delete t; };
+    }, &deserializer.instrumentation());
+
+    runner.run(QSL("deserialize-json/%1").arg(name), payload, [&deserializer, &json] () -> std::function<void()> {
+        T* t = deserializer.deserialize(json);
+        return [t] { delete t; };
+    }, &deserializer.instrumentation());
+
+    QScopedPointer<T> model(deserializer.deserialize(json));
+    runner.run(QSL("serialize/%1").arg(name), payload, [&serializer, &model] () -> std::function<void()> {
+        serializer.serialize<T>(model.data());
+        return [] {};
+    }, &serializer.instrumentation());
+}
+
+void bench_kodi(BenchRunner& runner, const QString& name, const Payload& payload)
+{
+    const QByteArray& jsonString = payload.bytes;
+    const QJsonObject json = QJsonDocument::fromJson(payload.bytes).object();
+    lqo::Deserializer<KodiResponse> deserializer;
+    lqo::Serializer serializer;
+
+    runner.run(QSL("deserialize/%1").arg(name), payload, [&deserializer, &jsonString] () -> std::function<void()> {
+        KodiResponse* r = deserializer.deserialize(jsonString);
+        return [r] { delete r; };
+    }, &deserializer.instrumentation());
+
+    runner.run(QSL("deserialize-json/%1").arg(name), payload, [&deserializer, &json] () -> std::function<void()> {
+        KodiResponse* r = deserializer.deserialize(json);
+        return [r] { delete r; };
+    }, &deserializer.instrumentation());
+
+    QScopedPointer<KodiResponse> model(deserializer.deserialize(json));
+    runner.run(QSL("serialize/%1").arg(name), payload, [&serializer, &model] () -> std::function<void()> {
+        serializer.serialize<KodiResponse>(model.data());
+        return [] {};
+    }, &serializer.instrumentation());
+}
+
+void bench_github(BenchRunner& runner, const QString& name, const Payload& payload)
+{
+    const QJsonArray json = QJsonDocument::fromJson(payload.bytes).array();
+    const QByteArray& bytes = payload.bytes;
+    lqo::Deserializer<LGHRepo> deserializer;
+    lqo::Serializer serializer;
+
+    runner.run(QSL("deserialize/%1").arg(name), payload, [&deserializer, &bytes] () -> std::function<void()> {
+        const QJsonArray array = QJsonDocument::fromJson(bytes).array();
+        QList<LGHRepo*> repos = deserializer.deserializeObjectArray(array);
+        return [repos] { qDeleteAll(repos); };
+    }, &deserializer.instrumentation());
+
+    runner.run(QSL("deserialize-json/%1").arg(name), payload, [&deserializer, &json] () -> std::function<void()> {
+        QList<LGHRepo*> repos = deserializer.deserializeObjectArray(json);
+        return [repos] { qDeleteAll(repos); };
+    }, &deserializer.instrumentation());
+
+    const QList<LGHRepo*> model = deserializer.deserializeObjectArray(json);
+    runner.run(QSL("serialize/%1").arg(name), payload, [&serializer, &model] () -> std::function<void()> {
+        serializer.serialize(model, &LGHRepo::staticMetaObject);
+        return [] {};
+    }, &serializer.instrumentation());
+    qDeleteAll(model);
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QSL("LQObjectSerializerBench"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QSL("Measures serialization and deserialization throughput."));
+    parser.addHelpOption();
+    QCommandLineOption itemsOption(QSL("items"), QSL("Number of elements in huge documents."), QSL("count"), QSL("10000"));
+    QCommandLineOption iterationsOption(QSL("iterations"), QSL("Number of measured iterations per benchmark."), QSL("count"), QSL("50"));
+    QCommandLineOption seedOption(QSL("seed"), QSL("Seed used to generate the documents."), QSL("seed"), QSL("1"));
+    QCommandLineOption filterOption(QSL("filter"), QSL("Only run benchmarks whose name contains this string."), QSL("filter"));
+    QCommandLineOption labelOption(QSL("label"), QSL("Label stored in the report, e.g. the version being measured."), QSL("label"));
+    QCommandLineOption outputOption(QSL("output"), QSL("Write the JSON report to this file instead of stdout."), QSL("path"));
+    parser.addOptions({ itemsOption, iterationsOption, seedOption, filterOption, labelOption, outputOption });
+    parser.process(app);
+
+#ifdef INSTRUMENT_LQOBJECTSERIALIZER
+    lqo::setAllocationCounter(&allocation_count);
+#endif
+
+    qRegisterMetaType<Item*>();
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    // Lets arrays of items be built in bulk instead of through the adder.
+    qRegisterMetaType<QList<Item*> >();
+#endif
+    qRegisterMetaType<Menu*>();
+    qRegisterMetaType<Glossary*>();
+    qRegisterMetaType<GlossDivObj*>();
+    qRegisterMetaType<GlossListObj*>();
+    qRegisterMetaType<GlossEntryObj*>();
+    qRegisterMetaType<GlossDefObj*>();
+    qRegisterMetaType<KodiResponseItem*>();
+    qRegisterMetaType<KodiResponseResult*>();
+    qRegisterMetaType<KodiResponse*>();
+    qRegisterMetaType<KodiResponseItem>();
+    qRegisterMetaType<KodiResponseResult>();
+    qRegisterMetaType<KodiResponse>();
+    qRegisterMetaType<LGHOwner*>();
+    qRegisterMetaType<LGHRepo*>();
+    qRegisterMetaType<LGHOwner>();
+    qRegisterMetaType<LGHRepo>();
+
+    const int items = qMax(1, parser.value(itemsOption).toInt());
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+    const quint32 seed = parser.value(seedOption).toUInt();
+
+    PayloadGenerator generator(seed);
+    BenchRunner runner(iterations, parser.value(filterOption));
+    bench_qobject<MenuRoot>(runner, QSL("menu/qobject/small"), generator.menu(22));
+    bench_qobject<MenuRoot>(runner, QSL("menu/qobject/huge"), generator.menu(items));
+    bench_qobject<GlossaryRoot>(runner, QSL("glossary/qobject/small"), generator.glossary(2));
+    bench_qobject<GlossaryRoot>(runner, QSL("glossary/qobject/huge"), generator.glossary(items));
+    bench_kodi(runner, QSL("kodi/gadget/small"), generator.kodiResponse());
+    bench_github(runner, QSL("github/gadget/small"), generator.githubRepos(22));
+    bench_github(runner, QSL("github/gadget/huge"), generator.githubRepos(items));
+
+    QJsonArray results;
+    for (const BenchResult& result : runner.results())
+        results.append(result.toJson());
+
+    QJsonObject config;
+    config[QSL("items")] = items;
+    config[QSL("iterations")] = iterations;
+    config[QSL("seed")] = static_cast<qint64>(seed);
+
+    QJsonObject report;
+    report[QSL("label")] = parser.value(labelOption);
+    report[QSL("qtVersion")] = QString(qVersion());
+    report[QSL("config")] = config;
+    report[QSL("results")] = results;
+
+    const QByteArray reportData = QJsonDocument(report).toJson();
+    if (!parser.isSet(outputOption)) {
+        QTextStream(stdout) << reportData;
+        return 0;
+    }
+
+    QFile output(parser.value(outputOption));
+    if (!output.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open" << output.fileName();
+        return 1;
+    }
+    output.write(reportData);
+
+    return 0;
+}
+
+#include "lqobjectserializerbench.moc"
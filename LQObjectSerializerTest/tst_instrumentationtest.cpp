@@ -0,0 +1,129 @@
+﻿/**
+ * MIT License
+ *
+ * Copyright (c) 2020 Luca Carlon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include <QtTest>
+#include <QObject>
+
+#include "../LQObjectSerializer/lserializer.h"
+#include "../deps/lqtutils/lqtutils_qsl.h"
+
+#ifndef INSTRUMENT_LQOBJECTSERIALIZER
+#error "This test must be built with INSTRUMENT_LQOBJECTSERIALIZER defined"
+#endif
+
+L_BEGIN_CLASS(InstrChild)
+L_RW_PROP(QString, name, setName, QString())
+L_END_CLASS
+
+L_BEGIN_CLASS(InstrObject)
+L_RW_PROP(int, someInt, setSomeInt, 0)
+L_RW_PROP(InstrChild*, child, setChild, nullptr)
+L_END_CLASS
+
+class LInstrumentationTestCase : public QObject
+{
+    Q_OBJECT
+public:
+    LInstrumentationTestCase();
+
+private slots:
+    void test_case1();
+    void test_case2();
+    void test_case3();
+};
+
+LInstrumentationTestCase::LInstrumentationTestCase()
+{
+    qRegisterMetaType<InstrChild*>();
+    qRegisterMetaType<InstrObject*>();
+}
+
+void LInstrumentationTestCase::test_case1()
+{
+    // Success path: one root, one child, three properties written.
+    lqo::Deserializer<InstrObject> deserializer;
+    QScopedPointer<InstrObject> object(deserializer.deserialize(
+        QByteArrayLiteral("{\"someInt\": 5, \"child\": {\"name\": \"a\"}}")));
+    QVERIFY(object);
+    QVERIFY(object->child());
+    QCOMPARE(object->child()->name(), QSL("a"));
+
+    const lqo::InstrumentationStats& last = deserializer.instrumentation().lastCall();
+    QCOMPARE(last.counters.instantiations, quint64(2));
+    QCOMPARE(last.counters.propertyWrites, quint64(3));
+    QCOMPARE(last.perMetaObject.value(&InstrObject::staticMetaObject).instantiations, quint64(1));
+    QCOMPARE(last.perMetaObject.value(&InstrObject::staticMetaObject).propertyWrites, quint64(2));
+    QCOMPARE(last.perMetaObject.value(&InstrChild::staticMetaObject).instantiations, quint64(1));
+    QCOMPARE(last.perMetaObject.value(&InstrChild::staticMetaObject).propertyWrites, quint64(1));
+    QCOMPARE(deserializer.instrumentation().total().counters.instantiations, quint64(2));
+
+    // A second call replaces the last call and accumulates into the total.
+    delete deserializer.deserialize(QByteArrayLiteral("{\"someInt\": 6}"));
+    QCOMPARE(deserializer.instrumentation().lastCall().counters.instantiations, quint64(1));
+    QCOMPARE(deserializer.instrumentation().lastCall().counters.propertyWrites, quint64(1));
+    QCOMPARE(deserializer.instrumentation().total().counters.instantiations, quint64(3));
+    QCOMPARE(deserializer.instrumentation().total().counters.propertyWrites, quint64(4));
+}
+
+void LInstrumentationTestCase::test_case2()
+{
+    // Error path: a malformed document aborts in strict mode before anything is built.
+    lqo::Deserializer<InstrObject> deserializer;
+    deserializer.setStrict(true);
+    InstrObject* object = deserializer.deserialize(QByteArrayLiteral("{\"someInt\": 5,"));
+    QVERIFY(!object);
+    QCOMPARE(deserializer.errorCount(), 1);
+
+    const lqo::InstrumentationStats& last = deserializer.instrumentation().lastCall();
+    QCOMPARE(last.counters.instantiations, quint64(0));
+    QCOMPARE(last.counters.propertyWrites, quint64(0));
+    QCOMPARE(deserializer.instrumentation().total().counters.instantiations, quint64(0));
+
+    // A limit exceeded during the scan of the input is an error path as well.
+    lqo::Limits limits;
+    limits.maxDepth = 1;
+    deserializer.setLimits(limits);
+    QVERIFY(!deserializer.deserialize(QByteArrayLiteral("{\"child\": {\"name\": \"a\"}}")));
+    QCOMPARE(deserializer.instrumentation().lastCall().counters.instantiations, quint64(0));
+    QCOMPARE(deserializer.instrumentation().lastCall().counters.propertyWrites, quint64(0));
+}
+
+void LInstrumentationTestCase::test_case3()
+{
+    // Serialization reads each property once, objectName included.
+    InstrObject object;
+    object.setSomeInt(3);
+    lqo::Serializer serializer;
+    QJsonObject json = serializer.serialize(&object);
+    QCOMPARE(json.value(QSL("someInt")).toInt(), 3);
+
+    const lqo::InstrumentationStats& last = serializer.instrumentation().lastCall();
+    QCOMPARE(last.counters.propertyReads, quint64(InstrObject::staticMetaObject.propertyCount()));
+    QCOMPARE(last.perMetaObject.value(&InstrObject::staticMetaObject).propertyReads,
+             quint64(InstrObject::staticMetaObject.propertyCount()));
+}
+
+QTEST_GUILESS_MAIN(LInstrumentationTestCase)
+
+#include "tst_instrumentationtest.moc"
@@ -89,6 +89,13 @@ L_RW_PROP(QString, id, setId, QString())
 L_RW_PROP(QString, label, setLabel, QString())
 L_END_CLASS
 
+Q_DECLARE_METATYPE(lqo::Columnar<Item>)
+
+L_BEGIN_CLASS(ColumnarMenu)
+L_RW_PROP(QString, header, setHeader)
+L_RW_PROP(lqo::Columnar<Item>, items, setItems)
+L_END_CLASS
+
 L_BEGIN_CLASS(Menu)
 L_RW_PROP(QString, header, setHeader)
 L_RW_PROP_ARRAY_WITH_ADDER(Item*, items, setItems)
@@ -149,6 +156,14 @@ public:
     }
 L_END_GADGET
 
+L_BEGIN_GADGET(PersonHolder)
+L_RW_GPROP(FPersonInfo*, person, setPerson, nullptr)
+public:
+    virtual ~PersonHolder() {
+        delete m_person;
+    }
+L_END_GADGET
+
 L_BEGIN_GADGET(KodiResponseVariant)
 L_RW_GPROP(int, id, setId)
 L_RW_GPROP(QString, jsonrpc, setJsonrpc)
@@ -199,6 +214,115 @@ L_RW_GPROP_AS(NotSerializable, notSerializable)
 L_END_GADGET
 Q_DECLARE_METATYPE(MyRect)
 
+L_BEGIN_CLASS(ErrorTest)
+L_RW_PROP(int, number, setNumber, 0)
+L_RW_PROP(QList<QRect>, rects, setRects)
+L_RW_PROP(Item*, item, setItem, nullptr)
+L_END_CLASS
+
+L_BEGIN_CLASS(BulkTest)
+L_RW_PROP(QList<Item*>, items, setItems)
+public:
+    Q_INVOKABLE void add_items(void* o) { m_adderCalls++; m_items.append(reinterpret_cast<Item*>(o)); }
+    int adderCalls() const { return m_adderCalls; }
+private:
+    int m_adderCalls = 0;
+L_END_CLASS
+
+L_BEGIN_CLASS(NestedTest)
+L_RW_PROP(QList<QList<double>>, points, setPoints)
+L_RW_PROP(QList<QList<int>>, matrix, setMatrix)
+L_RW_PROP(QList<QList<QString>>, words, setWords)
+L_END_CLASS
+
+struct Sample
+{
+    Q_GADGET
+    Q_PROPERTY(double t MEMBER t)
+    Q_PROPERTY(double v MEMBER v)
+public:
+    double t = 0;
+    double v = 0;
+    bool operator==(const Sample& other) const { return t == other.t && v == other.v; }
+    bool operator!=(const Sample& other) const { return !(*this == other); }
+};
+Q_DECLARE_METATYPE(Sample)
+
+class SampleSeries : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QList<Sample> samples MEMBER m_samples)
+    Q_PROPERTY(std::vector<Sample> vector MEMBER m_vector)
+    Q_PROPERTY(QHash<QString, Sample> named MEMBER m_named)
+public:
+    SampleSeries(QObject* parent = nullptr) : QObject(parent) {}
+    QList<Sample> m_samples;
+    std::vector<Sample> m_vector;
+    QHash<QString, Sample> m_named;
+};
+
+L_BEGIN_CLASS(RawTest)
+L_RW_PROP(QString, id, setId)
+L_RW_PROP(lqo::RawJson, extensions, setExtensions)
+L_END_CLASS
+
+L_BEGIN_CLASS(RawListTest)
+L_RW_PROP(QList<lqo::RawJson>, fragments, setFragments)
+L_END_CLASS
+
+L_BEGIN_CLASS(ValidateTest)
+Q_CLASSINFO("lqo.required", "id, menu")
+L_RW_PROP(QString, id, setId)
+L_RW_PROP(int, count, setCount, 0)
+L_RW_PROP(QList<QList<int>>, matrix, setMatrix)
+L_RW_PROP(Menu*, menu, setMenu, nullptr)
+L_END_CLASS
+
+Q_DECLARE_METATYPE(QSharedPointer<MonitorSize>)
+
+L_BEGIN_CLASS(SharedTest)
+L_RW_PROP(QSharedPointer<MonitorSize>, a, setA)
+L_RW_PROP(QSharedPointer<MonitorSize>, b, setB)
+L_RW_PROP(QSharedPointer<MonitorSize>, c, setC)
+L_END_CLASS
+
+L_BEGIN_CLASS(Shape)
+L_RW_PROP(QString, name, setName)
+L_END_CLASS
+
+class Circle : public Shape
+{
+    Q_OBJECT
+    L_RW_PROP_AS(double, radius, 0)
+public:
+    Q_INVOKABLE Circle(QObject* parent = nullptr) : Shape(parent) {}
+};
+
+class Rect : public Shape
+{
+    Q_OBJECT
+    L_RW_PROP_AS(int, w, 0)
+    L_RW_PROP_AS(int, h, 0)
+public:
+    Q_INVOKABLE Rect(QObject* parent = nullptr) : Shape(parent) {}
+};
+
+L_BEGIN_CLASS(Drawing)
+L_RW_PROP(Shape*, background, setBackground, nullptr)
+L_RW_PROP_ARRAY_WITH_ADDER(Shape*, shapes, setShapes)
+L_END_CLASS
+
+L_BEGIN_CLASS(Node)
+L_RW_PROP(QString, name, setName)
+L_RW_PROP(Node*, child, setChild, nullptr)
+L_END_CLASS
+
+L_BEGIN_CLASS(Link)
+L_RW_PROP(QByteArray, id, setId)
+L_RW_PROP(QByteArray, url, setUrl)
+L_RW_PROP(QByteArray, title, setTitle)
+L_END_CLASS
+
 class InheritedType : public Menu
 {
     Q_OBJECT
@@ -207,6 +331,25 @@ public:
     InheritedType(QObject* parent = nullptr) : Menu(parent) {}
 };
 
+class ChildEventRecorder : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ChildEventRecorder(Menu* menu) : m_menu(menu) { menu->installEventFilter(this); }
+    const QList<int>& itemCounts() const { return m_itemCounts; }
+
+protected:
+    bool eventFilter(QObject* watched, QEvent* event) override {
+        if (event->type() == QEvent::ChildAdded)
+            m_itemCounts.append(m_menu->items().size());
+        return QObject::eventFilter(watched, event);
+    }
+
+private:
+    Menu* m_menu;
+    QList<int> m_itemCounts;
+};
+
 class LQObjectSerializerTest : public QObject
 {
     Q_OBJECT
@@ -233,6 +376,29 @@ private slots:
     void test_case14();
     void test_case15();
     void test_case16();
+    void test_case17();
+    void test_case18();
+    void test_case19();
+    void test_case20();
+    void test_case21();
+    void test_case22();
+    void test_case23();
+    void test_case24();
+    void test_case25();
+    void test_case26();
+    void test_case27();
+    void test_case28();
+    void test_case29();
+    void test_case30();
+    void test_case31();
+    void test_case32();
+    void test_case33();
+    void test_case34();
+    void test_case35();
+    void test_case36();
+    void test_case37();
+    void test_case38();
+    void test_case39();
 };
 
 LQObjectSerializerTest::LQObjectSerializerTest()
@@ -368,6 +534,13 @@ void LQObjectSerializerTest::test_case1()
 
     QCOMPARE(res->someInt(), 7);
     QCOMPARE(res->someLong(), std::numeric_limits<int>::max() + static_cast<qint64>(10));
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    // Integers beyond 2^53 are not rounded through double.
+    QScopedPointer<SomeQObject> longRes(deserializer.deserialize("{\"someLong\": 9007199254740993}"));
+    QCOMPARE(longRes->someLong(), Q_INT64_C(9007199254740993));
+    QCOMPARE(serializer.serialize(longRes.data())[QSL("someLong")].toInteger(), Q_INT64_C(9007199254740993));
+    QVERIFY(serializer.serializeToJson(longRes.data()).contains("\"someLong\":9007199254740993"));
+#endif
     QCOMPARE(res->someBool(), true);
     QCOMPARE(res->someDouble(), 7.6);
     QCOMPARE(res->someString(), QSL("HELLO"));
@@ -882,6 +1055,1098 @@ void LQObjectSerializerTest::test_case16()
     QCOMPARE(des->myStruct(), TypeSerializationStruct(1, QSL("2")));
 }
 
+void LQObjectSerializerTest::test_case17()
+{
+    QFile jsonFile(":/json_2.json");
+    QVERIFY(jsonFile.open(QIODevice::ReadOnly));
+
+    const QString jsonString = QString::fromUtf8(jsonFile.readAll());
+
+    QSharedPointer<lqo::StatsCollector> stats(new lqo::StatsCollector);
+    lqo::Deserializer<MenuRoot> deserializer;
+    deserializer.setStatsCollector(stats);
+    QScopedPointer<MenuRoot> g(deserializer.deserialize(jsonString));
+    QVERIFY(g->menu());
+
+    // Data from other threads is merged when read.
+    QScopedPointer<QThread> thread(QThread::create([stats, &jsonString] {
+        lqo::Deserializer<MenuRoot> deserializer;
+        deserializer.setStatsCollector(stats);
+        delete deserializer.deserialize(jsonString);
+    }));
+    thread->start();
+    QVERIFY(thread->wait());
+
+    lqo::Serializer serializer;
+    serializer.setStatsCollector(stats);
+    serializer.serialize<MenuRoot>(g.data());
+
+    const QHash<const QMetaObject*, lqo::TypeStats> snapshot = stats->snapshot();
+    QCOMPARE(snapshot[&MenuRoot::staticMetaObject].objects, quint64(3));
+    QCOMPARE(snapshot[&MenuRoot::staticMetaObject].bytesIn, quint64(2*jsonString.toUtf8().size()));
+    QCOMPARE(snapshot[&Menu::staticMetaObject].objects, quint64(3));
+    QCOMPARE(snapshot[&Item::staticMetaObject].objects, quint64(3*18));
+    QCOMPARE(snapshot[&Item::staticMetaObject].warnings, quint64(0));
+    QVERIFY(snapshot[&MenuRoot::staticMetaObject].nsecs > 0);
+
+    const QJsonObject json = stats->toJson();
+    QCOMPARE(json[QSL("Item")].toObject()[QSL("objects")].toInt(), 3*18);
+
+    stats->reset();
+    QCOMPARE(stats->snapshot()[&Item::staticMetaObject].objects, quint64(0));
+}
+
+void LQObjectSerializerTest::test_case18()
+{
+    QFile jsonFile(":/json_2.json");
+    QVERIFY(jsonFile.open(QIODevice::ReadOnly));
+
+    const QByteArray jsonString = jsonFile.readAll();
+
+    lqo::Deserializer<MenuRoot> deserializer;
+    QFuture<MenuRoot*> future = deserializer.deserializeAsync(jsonString);
+    future.waitForFinished();
+    QVERIFY(!future.isCanceled());
+
+    QScopedPointer<MenuRoot> g(future.result());
+    QVERIFY(g);
+    QCOMPARE(g->thread(), QThread::currentThread());
+    QCOMPARE(g->menu()->thread(), QThread::currentThread());
+    QCOMPARE(g->menu()->items().size(), 22);
+    QCOMPARE(g->menu()->items().at(1)->label(), QSL("Open New"));
+
+    // An expired deadline abandons the deserialization.
+    QFuture<MenuRoot*> expired = deserializer.deserializeAsync(jsonString, QDeadlineTimer(0));
+    expired.waitForFinished();
+    QVERIFY(expired.isCanceled());
+    QCOMPARE(expired.resultCount(), 0);
+
+    // A bad payload is not a cancellation: the result is null and errors are reported.
+    QSharedPointer<QVector<lqo::Error> > errors(new QVector<lqo::Error>);
+    deserializer.setStrict(true);
+    QFuture<MenuRoot*> failed = deserializer.deserializeAsync("{\"menu\": ", QDeadlineTimer(QDeadlineTimer::Forever),
+                                                              QThreadPool::globalInstance(), errors);
+    failed.waitForFinished();
+    QVERIFY(!failed.isCanceled());
+    QCOMPARE(failed.resultCount(), 1);
+    QVERIFY(!failed.result());
+    QCOMPARE(errors->size(), 1);
+    QCOMPARE(errors->first().code, lqo::Error::ParseError);
+
+    // The parse error is still reported as such when the deadline has expired.
+    QFuture<MenuRoot*> failedLate = deserializer.deserializeAsync("{\"menu\": ", QDeadlineTimer(0),
+                                                                  QThreadPool::globalInstance(), errors);
+    failedLate.waitForFinished();
+    QVERIFY(!failedLate.isCanceled());
+    QCOMPARE(failedLate.resultCount(), 1);
+    QVERIFY(!failedLate.result());
+    QCOMPARE(errors->first().code, lqo::Error::ParseError);
+
+    // QObject's held by gadgets are moved too.
+    lqo::Deserializer<PersonHolder> holderDeserializer;
+    QFuture<PersonHolder*> holderFuture = holderDeserializer.deserializeAsync("{\"person\": {\"name\": \"Andrew\", \"more\": {}}}");
+    holderFuture.waitForFinished();
+    QScopedPointer<PersonHolder> holder(holderFuture.result());
+    QVERIFY(holder);
+    QVERIFY(holder->person());
+    QCOMPARE(holder->person()->name(), QSL("Andrew"));
+    QCOMPARE(holder->person()->thread(), QThread::currentThread());
+    QVERIFY(holder->person()->more());
+    QCOMPARE(holder->person()->more()->thread(), QThread::currentThread());
+}
+
+void LQObjectSerializerTest::test_case19()
+{
+    QFile jsonFile(":/json_3.json");
+    QVERIFY(jsonFile.open(QIODevice::ReadOnly));
+
+    const QByteArray jsonString = jsonFile.readAll();
+    QBuffer buffer;
+    buffer.setData(jsonString);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    // Members are available as soon as they are complete.
+    lqo::IncrementalDeserializer<FPersonInfo> deserializer;
+    QVERIFY(deserializer.feed(buffer.read(jsonString.indexOf(',') + 1)));
+    QVERIFY(deserializer.object());
+    QCOMPARE(deserializer.object()->name(), QSL("Andrew"));
+    QVERIFY(!deserializer.isFinished());
+
+    while (!buffer.atEnd())
+        QVERIFY(deserializer.feed(buffer.read(5)));
+    QVERIFY(deserializer.isFinished());
+    QVERIFY(!deserializer.hasError());
+
+    QScopedPointer<FPersonInfo> g(deserializer.takeObject());
+    QVERIFY(g);
+    QCOMPARE(g->age(), 33);
+    QCOMPARE(g->identifiers(), QList<int>() << 32 << 45 << 67 << 78);
+    QVERIFY(g->more());
+    QVERIFY(g->more()->valid());
+    QCOMPARE(g->more()->gps(), QSL("44.9064', W073° 59.0735'"));
+
+    deserializer.reset();
+    QVERIFY(!deserializer.feed(QByteArray("{\"name\": \"Andrew\",}")));
+    QVERIFY(deserializer.hasError());
+
+    deserializer.reset();
+    QVERIFY(!deserializer.feed(QByteArray("[1, 2]")));
+
+    // A single large member is deserialized only once its last byte is received.
+    QFile menuFile(":/json_2.json");
+    QVERIFY(menuFile.open(QIODevice::ReadOnly));
+    const QByteArray menuJson = menuFile.readAll();
+    const int menuEnd = menuJson.lastIndexOf('}') - 1;
+    lqo::IncrementalDeserializer<MenuRoot> menuDeserializer;
+    for (int i = 0; i < menuEnd; i += 32) {
+        QVERIFY(menuDeserializer.feed(menuJson.mid(i, qMin(32, menuEnd - i))));
+        QVERIFY(!menuDeserializer.object());
+    }
+    QVERIFY(menuDeserializer.feed(menuJson.mid(menuEnd, 1)));
+    QVERIFY(menuDeserializer.object());
+    QCOMPARE(menuDeserializer.object()->menu()->items().size(), 22);
+    QVERIFY(!menuDeserializer.isFinished());
+    QVERIFY(menuDeserializer.feed(menuJson.mid(menuEnd + 1)));
+    QVERIFY(menuDeserializer.isFinished());
+}
+
+void LQObjectSerializerTest::test_case20()
+{
+    const QByteArray jsonString("{\"number\": {\"a\": 1}, \"rects\": [{\"x\": 1}],"
+                                " \"item\": {\"id\": \"a\", \"label\": {\"b\": 2}}}");
+
+    lqo::Deserializer<ErrorTest> deserializer;
+    QScopedPointer<ErrorTest> g(deserializer.deserialize(jsonString));
+    QVERIFY(g);
+    QCOMPARE(g->item()->id(), QSL("a"));
+    QCOMPARE(deserializer.errorCount(), 3);
+    QCOMPARE(deserializer.errors().size(), 3);
+    QCOMPARE(deserializer.errors().at(0).code, lqo::Error::UnknownType);
+    QCOMPARE(deserializer.errors().at(0).path, QSL("item.label"));
+    QCOMPARE(deserializer.errors().at(1).code, lqo::Error::UnknownType);
+    QCOMPARE(deserializer.errors().at(1).path, QSL("number"));
+    QCOMPARE(deserializer.errors().at(2).code, lqo::Error::MissingAdder);
+    QCOMPARE(deserializer.errors().at(2).path, QSL("rects"));
+    QCOMPARE(deserializer.errors().at(2).property, QSL("rects"));
+
+    deserializer.setMaxErrors(1);
+    g.reset(deserializer.deserialize(jsonString));
+    QVERIFY(g);
+    QCOMPARE(deserializer.errorCount(), 3);
+    QCOMPARE(deserializer.errors().size(), 1);
+
+    deserializer.setMaxErrors(-1);
+    deserializer.setStrict(true);
+    g.reset(deserializer.deserialize(jsonString));
+    QVERIFY(!g);
+    QCOMPARE(deserializer.errors().size(), 1);
+
+    g.reset(deserializer.deserialize(QByteArray("{\"number\": ")));
+    QVERIFY(!g);
+    QCOMPARE(deserializer.errors().at(0).code, lqo::Error::ParseError);
+}
+
+void LQObjectSerializerTest::test_case21()
+{
+    QJsonArray items;
+    for (int i = 0; i < 1000; i++) {
+        QJsonObject item;
+        item[QSL("id")] = QString::number(i);
+        items.append(i == 10 ? QJsonValue(QJsonValue::Null) : QJsonValue(item));
+    }
+
+    QJsonObject json;
+    json[QSL("items")] = items;
+
+    // On Qt 6 registered list types are assigned through the setter, with no adder calls.
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    qRegisterMetaType<QList<Item*> >();
+    const int adderCalls = 0;
+#else
+    const int adderCalls = 1000;
+#endif
+    lqo::Deserializer<BulkTest> deserializer;
+    QScopedPointer<BulkTest> g(deserializer.deserialize(json));
+    QVERIFY(g);
+    QVERIFY(deserializer.errors().isEmpty());
+    QCOMPARE(g->items().size(), 1000);
+    QVERIFY(!g->items().at(10));
+    QCOMPARE(g->items().at(999)->id(), QSL("999"));
+    QCOMPARE(g->items().at(999)->parent(), g.data());
+    QCOMPARE(g->adderCalls(), adderCalls);
+
+    // Populating appends to the current list.
+    QVERIFY(deserializer.populate(QJsonDocument(json).toJson(), g.data()));
+    QCOMPARE(g->items().size(), 2000);
+    QCOMPARE(g->items().at(1999)->id(), QSL("999"));
+    QCOMPARE(g->adderCalls(), 2 * adderCalls);
+}
+
+void LQObjectSerializerTest::test_case22()
+{
+    const QByteArray jsonString("{\"points\": [[1.5, 2], [3, 4.25]], \"matrix\": [[1, 2, 3], [], [4]],"
+                                " \"words\": [[\"a\", \"b\"], []]}");
+
+    lqo::Deserializer<NestedTest> deserializer;
+    QScopedPointer<NestedTest> g(deserializer.deserialize(jsonString));
+    QVERIFY(g);
+    QVERIFY(deserializer.errors().isEmpty());
+    QCOMPARE(g->points().size(), 2);
+    QCOMPARE(g->points().at(0), QList<double>() << 1.5 << 2);
+    QCOMPARE(g->points().at(1), QList<double>() << 3 << 4.25);
+    QCOMPARE(g->matrix().size(), 3);
+    QCOMPARE(g->matrix().at(0), QList<int>() << 1 << 2 << 3);
+    QVERIFY(g->matrix().at(1).isEmpty());
+    QCOMPARE(g->matrix().at(2), QList<int>() << 4);
+    QCOMPARE(g->words().size(), 2);
+    QCOMPARE(g->words().at(0), QList<QString>() << QSL("a") << QSL("b"));
+    QVERIFY(g->words().at(1).isEmpty());
+
+    lqo::Serializer serializer;
+    QCOMPARE(serializer.serialize<NestedTest>(g.data()), QJsonDocument::fromJson(jsonString).object());
+}
+
+void LQObjectSerializerTest::test_case23()
+{
+    lqo::registerGadgetArray<Sample>();
+
+    const QByteArray jsonString("{\"samples\": [{\"t\": 1, \"v\": 2.5}, {\"t\": 2, \"v\": 3}],"
+                                " \"vector\": [{\"t\": 3, \"v\": 4}]}");
+
+    lqo::Deserializer<SampleSeries> deserializer;
+    QScopedPointer<SampleSeries> g(deserializer.deserialize(jsonString));
+    QVERIFY(g);
+    QVERIFY(deserializer.errors().isEmpty());
+    QCOMPARE(g->m_samples.size(), 2);
+    QCOMPARE(g->m_samples.at(0).t, 1.0);
+    QCOMPARE(g->m_samples.at(0).v, 2.5);
+    QCOMPARE(g->m_samples.at(1).t, 2.0);
+    QCOMPARE(g->m_vector.size(), size_t(1));
+    QCOMPARE(g->m_vector.at(0).v, 4.0);
+
+    lqo::Serializer serializer;
+    const QJsonObject json = serializer.serialize<SampleSeries>(g.data());
+    QCOMPARE(json[QSL("samples")], QJsonDocument::fromJson(jsonString).object()[QSL("samples")]);
+    QCOMPARE(json[QSL("vector")], QJsonDocument::fromJson(jsonString).object()[QSL("vector")]);
+}
+
+void LQObjectSerializerTest::test_case24()
+{
+    const QByteArray jsonString("{\"test1\": {\"a\": 1, \"b\": 2}, \"test3\": {\"x\": {\"objectName\": \"X\"}}}");
+
+    lqo::Deserializer<HashTest> deserializer;
+    QScopedPointer<HashTest> g(deserializer.deserialize(jsonString));
+    QVERIFY(g);
+    QVERIFY(deserializer.errors().isEmpty());
+    QCOMPARE(g->test1().size(), 2);
+    QCOMPARE(g->test1().value(QSL("a")), 1);
+    QCOMPARE(g->test1().value(QSL("b")), 2);
+    QCOMPARE(g->test3().size(), 1);
+    QVERIFY(g->test3().value(QSL("x")));
+    QCOMPARE(g->test3().value(QSL("x"))->objectName(), QSL("X"));
+
+    lqo::Serializer serializer;
+    QCOMPARE(serializer.serialize<HashTest>(g.data())[QSL("test1")], QJsonDocument::fromJson(jsonString).object()[QSL("test1")]);
+    qDeleteAll(g->test3());
+
+    // Gadgets stored by value.
+    lqo::registerGadgetDictionary<Sample>();
+    const QByteArray samplesString("{\"named\": {\"a\": {\"t\": 1, \"v\": 2}, \"b\": {\"t\": 3, \"v\": 4}}}");
+    lqo::Deserializer<SampleSeries> samplesDeserializer;
+    QScopedPointer<SampleSeries> samples(samplesDeserializer.deserialize(samplesString));
+    QVERIFY(samples);
+    QVERIFY(samplesDeserializer.errors().isEmpty());
+    QCOMPARE(samples->m_named.size(), 2);
+    QCOMPARE(samples->m_named.value(QSL("b")).v, 4.0);
+    QCOMPARE(serializer.serialize<SampleSeries>(samples.data())[QSL("named")],
+             QJsonDocument::fromJson(samplesString).object()[QSL("named")]);
+}
+
+void LQObjectSerializerTest::test_case25()
+{
+    const QByteArray extensions("{\"x\": [1, 2, {\"y\": null}]}");
+    const QByteArray jsonString("{\"id\": \"a\", \"extensions\": " + extensions + "}");
+
+    lqo::Deserializer<RawTest> deserializer;
+    QScopedPointer<RawTest> g(deserializer.deserialize(jsonString));
+    QVERIFY(g);
+    QCOMPARE(g->id(), QSL("a"));
+    QVERIFY(!g->extensions().isNull());
+    QCOMPARE(g->extensions().value().toObject()[QSL("x")].toArray().size(), 3);
+    QCOMPARE(g->extensions().toJson(), QByteArray("{\"x\":[1,2,{\"y\":null}]}"));
+
+    lqo::Serializer serializer;
+    QCOMPARE(serializer.serialize<RawTest>(g.data()), QJsonDocument::fromJson(jsonString).object());
+
+    // The incremental deserializer keeps the raw bytes.
+    lqo::IncrementalDeserializer<RawTest> incremental;
+    QVERIFY(incremental.feed(jsonString));
+    QVERIFY(incremental.isFinished());
+    QCOMPARE(incremental.object()->extensions().toJson(), extensions);
+    QCOMPARE(incremental.object()->extensions(), g->extensions());
+}
+
+void LQObjectSerializerTest::test_case26()
+{
+    RawTest raw;
+    raw.setId(QSL("a\"b"));
+    raw.setExtensions(lqo::RawJson::fromJson("{\"cached\": [1, 2]}"));
+
+    // Raw fragments are copied verbatim.
+    lqo::Serializer serializer;
+    QCOMPARE(serializer.serializeToJson(&raw), QByteArray("{\"id\":\"a\\\"b\",\"extensions\":{\"cached\": [1, 2]}}"));
+
+    raw.setExtensions(lqo::RawJson::fromJson("{\"cached\": "));
+    serializer.setValidateRawJson(true);
+    QCOMPARE(serializer.serializeToJson(&raw), QByteArray("{\"id\":\"a\\\"b\",\"extensions\":null}"));
+
+    // Null fragments in arrays are written as null, so indexes are kept.
+    RawListTest rawList;
+    rawList.setFragments(QList<lqo::RawJson>() << lqo::RawJson::fromJson("{\"a\":1}") << lqo::RawJson()
+                                               << lqo::RawJson::fromJson("[2]"));
+    QCOMPARE(serializer.serializeToJson(&rawList), QByteArray("{\"fragments\":[{\"a\":1},null,[2]]}"));
+
+    QFile jsonFile(":/json_2.json");
+    QVERIFY(jsonFile.open(QIODevice::ReadOnly));
+    lqo::Deserializer<MenuRoot> deserializer;
+    QScopedPointer<MenuRoot> g(deserializer.deserialize(jsonFile.readAll()));
+    QVERIFY(g);
+    QCOMPARE(QJsonDocument::fromJson(serializer.serializeToJson(g.data())).object(), serializer.serialize(g.data()));
+}
+
+void LQObjectSerializerTest::test_case27()
+{
+    lqo::Deserializer<ValidateTest> deserializer;
+    QVERIFY(deserializer.validate(QByteArray("{\"id\": \"a\", \"count\": 1, \"matrix\": [[1], [2, 3]],"
+                                             " \"menu\": {\"header\": \"h\", \"items\": [null, {\"id\": \"i\"}]}}")));
+    QVERIFY(deserializer.errors().isEmpty());
+
+    QVERIFY(!deserializer.validate(QByteArray("{\"count\": \"one\", \"matrix\": [[1], 2],"
+                                              " \"menu\": {\"items\": [{\"id\": [1]}], \"footer\": 1}}")));
+    // Errors are reported in document order.
+    QCOMPARE(deserializer.errors().size(), 5);
+    QCOMPARE(deserializer.errors().at(0).code, lqo::Error::TypeMismatch);
+    QCOMPARE(deserializer.errors().at(0).path, QSL("count"));
+    QCOMPARE(deserializer.errors().at(1).code, lqo::Error::TypeMismatch);
+    QCOMPARE(deserializer.errors().at(1).path, QSL("matrix[1]"));
+    QCOMPARE(deserializer.errors().at(2).code, lqo::Error::TypeMismatch);
+    QCOMPARE(deserializer.errors().at(2).path, QSL("menu.items[0].id"));
+    QCOMPARE(deserializer.errors().at(3).code, lqo::Error::UnknownKey);
+    QCOMPARE(deserializer.errors().at(3).path, QSL("menu.footer"));
+    QCOMPARE(deserializer.errors().at(4).code, lqo::Error::MissingRequired);
+    QCOMPARE(deserializer.errors().at(4).property, QSL("id"));
+
+    QVERIFY(!deserializer.validate(QByteArray("[]")));
+    QVERIFY(!deserializer.validate(QByteArray("{")));
+    QCOMPARE(deserializer.errors().at(0).code, lqo::Error::ParseError);
+
+    // Text that is not valid JSON is rejected.
+    const char* malformed[] = {
+        "{\"id\": \"a\",}", "{\"id\" \"a\"}", "{\"id\": \"a\"} x", "{\"count\": 01}",
+        "{\"count\": 1.}", "{\"id\": \"\\x\"}", "{\"id\": \"a\nb\"}", "{\"matrix\": [[1],]}",
+        "{\"id\": tru}", "{\"matrix\": [[1]}"
+    };
+    for (const char* json : malformed) {
+        QVERIFY2(!deserializer.validate(QByteArray(json)), json);
+        QCOMPARE(deserializer.errors().last().code, lqo::Error::ParseError);
+    }
+
+    // Escapes are decoded before keys are matched.
+    QVERIFY(deserializer.validate(QByteArray("{\"\\u0069d\": \"\\ud83d\\ude00\", \"count\": -1.5e2, \"menu\": {}}")));
+}
+
+void LQObjectSerializerTest::test_case28()
+{
+    lqo::registerColumnar<Item>();
+
+    QFile jsonFile(":/json_2.json");
+    QVERIFY(jsonFile.open(QIODevice::ReadOnly));
+    const QJsonObject json = QJsonDocument::fromJson(jsonFile.readAll()).object()[QSL("menu")].toObject();
+
+    lqo::Deserializer<ColumnarMenu> deserializer;
+    QScopedPointer<ColumnarMenu> g(deserializer.deserialize(json));
+    QVERIFY(g);
+    QVERIFY(deserializer.errors().isEmpty());
+    QCOMPARE(g->header(), QSL("SVG Viewer"));
+
+    const lqo::Columns& items = g->items();
+    QCOMPARE(items.rowCount(), 22);
+    QCOMPARE(items.columnCount(), 2);
+    const int id = items.indexOf(QSL("id"));
+    const int label = items.indexOf(QSL("label"));
+    QCOMPARE(items.row(0).toString(id).toString(), QSL("Open"));
+    QVERIFY(items.row(0).toString(label).isEmpty());
+    QCOMPARE(items.row(1).toString(label).toString(), QSL("Open New"));
+    QVERIFY(items.row(2).toString(id).isEmpty());
+    QVERIFY(!items.row(1).isNull());
+    QVERIFY(items.row(2).isNull());
+    QCOMPARE(items.row(3).value(QSL("label")).toString(), QSL("Zoom In"));
+
+    // Null elements round-trip.
+    lqo::Serializer serializer;
+    const QJsonArray array = serializer.serialize(g.data())[QSL("items")].toArray();
+    QCOMPARE(array.size(), 22);
+    QCOMPARE(array.at(1).toObject()[QSL("label")].toString(), QSL("Open New"));
+    QCOMPARE(array, json[QSL("items")].toArray());
+
+    // Columnar arrays are validated against the schema.
+    QVERIFY(deserializer.validate(QJsonDocument(json).toJson()));
+    QVERIFY(deserializer.errors().isEmpty());
+
+    QJsonObject bad = json;
+    QJsonArray badItems = json[QSL("items")].toArray();
+    badItems.append(1);
+    bad[QSL("items")] = badItems;
+    QScopedPointer<ColumnarMenu> badMenu(deserializer.deserialize(bad));
+    QCOMPARE(badMenu->items().rowCount(), 23);
+    QVERIFY(badMenu->items().row(22).isNull());
+    QCOMPARE(deserializer.errors().size(), 1);
+    QCOMPARE(deserializer.errors().first().code, lqo::Error::TypeMismatch);
+    QCOMPARE(deserializer.errors().first().path, QSL("items[22]"));
+}
+
+void LQObjectSerializerTest::test_case29()
+{
+    QJsonArray array;
+    for (int i = 0; i < 120; i++) {
+        QJsonObject item;
+        item[QSL("id")] = QString::number(i);
+        item[QSL("label")] = QSL("label%1").arg(i);
+        array.append(item);
+    }
+    const QByteArray jsonString = QJsonDocument(array).toJson();
+
+    lqo::ObjectListModel model(&Item::staticMetaObject);
+    QSignalSpy spy(&model, &QAbstractItemModel::rowsInserted);
+    lqo::ObjectListModelFeeder<Item> feeder(&model, 50);
+    QVERIFY(feeder.feed(jsonString));
+    QVERIFY(feeder.isFinished());
+    QVERIFY(feeder.errors().isEmpty());
+
+    // Rows are inserted in batches.
+    QCOMPARE(spy.count(), 3);
+    QCOMPARE(spy.at(0).at(2).toInt(), 49);
+    QCOMPARE(spy.at(2).at(1).toInt(), 100);
+    QCOMPARE(model.rowCount(), 120);
+
+    const int labelRole = lqo::ObjectListModel::FirstPropertyRole + Item::staticMetaObject.indexOfProperty("label");
+    QCOMPARE(model.roleNames().value(labelRole), QByteArray("label"));
+    QCOMPARE(model.data(model.index(7), labelRole).toString(), QSL("label7"));
+    QCOMPARE(qobject_cast<Item*>(model.at(119))->id(), QSL("119"));
+
+    // Partial batches are shown at the end of each feed.
+    lqo::ObjectListModel slowModel(&Item::staticMetaObject);
+    lqo::ObjectListModelFeeder<Item> slowFeeder(&slowModel, 50);
+    const int firstEnd = jsonString.indexOf('}') + 1;
+    QVERIFY(slowFeeder.feed(jsonString.left(firstEnd)));
+    QCOMPARE(slowModel.rowCount(), 1);
+    for (int i = firstEnd; i < jsonString.size(); i += 64)
+        QVERIFY(slowFeeder.feed(jsonString.mid(i, 64)));
+    QVERIFY(slowFeeder.isFinished());
+    QCOMPARE(slowModel.rowCount(), 120);
+
+    feeder.reset();
+    QVERIFY(!feeder.feed(QByteArray("{\"id\": 1}")));
+}
+
+void LQObjectSerializerTest::test_case30()
+{
+    const QByteArray jsonString = QByteArrayLiteral(
+        "{\"a\": {\"w\": 1920, \"h\": 1080}, "
+        "\"b\": {\"h\": 1080, \"w\": 1920}, "
+        "\"c\": {\"w\": 1280, \"h\": 720}}");
+
+    lqo::registerSharedGadget<MonitorSize>();
+    lqo::Deserializer<SharedTest> deserializer;
+    QScopedPointer<SharedTest> distinct(deserializer.deserialize(jsonString));
+    QVERIFY(distinct->a() && distinct->b());
+    QVERIFY(distinct->a() != distinct->b());
+    QCOMPARE(distinct->a()->w(), 1920);
+
+    lqo::registerSharedGadget<MonitorSize>(true);
+    QScopedPointer<SharedTest> shared(deserializer.deserialize(jsonString));
+    QCOMPARE(shared->a(), shared->b());
+    QVERIFY(shared->a() != shared->c());
+    QCOMPARE(shared->c()->h(), 720);
+
+    // Instances are not shared across calls.
+    QScopedPointer<SharedTest> other(deserializer.deserialize(jsonString));
+    QVERIFY(other->a() != shared->a());
+
+    lqo::Serializer serializer;
+    const QJsonObject json = serializer.serialize(shared.data());
+    QCOMPARE(json[QSL("b")].toObject()[QSL("w")].toInt(), 1920);
+    QCOMPARE(json[QSL("c")].toObject()[QSL("h")].toInt(), 720);
+
+    // The deserializer keeps no reference once the call returns.
+    const QWeakPointer<MonitorSize> weak = shared->a();
+    shared.reset();
+    QVERIFY(weak.isNull());
+
+    QVERIFY(deserializer.validate(jsonString));
+    QVERIFY(deserializer.errors().isEmpty());
+    deserializer.setStrict(true);
+    QScopedPointer<SharedTest> strict(deserializer.deserialize(jsonString));
+    QVERIFY(strict);
+}
+
+void LQObjectSerializerTest::test_case31()
+{
+    QObject parent;
+    QList<Item*> items;
+    for (int i = 0; i < 100; i++) {
+        Item* item = new Item(&parent);
+        item->setId(QString::number(i));
+        item->setLabel(QSL("label%1").arg(i));
+        items.append(item);
+    }
+
+    QBuffer arrayBuffer;
+    QVERIFY(arrayBuffer.open(QIODevice::WriteOnly));
+    lqo::StreamSerializer arraySerializer(&arrayBuffer);
+    arraySerializer.setChunkSize(256);
+    QVERIFY(arraySerializer.write(items));
+    QVERIFY(arrayBuffer.size() > 0);
+    QVERIFY(arraySerializer.finish());
+    QCOMPARE(arraySerializer.count(), 100);
+    QCOMPARE(arraySerializer.bytesWritten(), arrayBuffer.size());
+
+    const QJsonArray array = QJsonDocument::fromJson(arrayBuffer.data()).array();
+    QCOMPARE(array.size(), 100);
+    QCOMPARE(array.at(42).toObject()[QSL("label")].toString(), QSL("label42"));
+    QVERIFY(!arraySerializer.write(items.first()));
+
+    QBuffer linesBuffer;
+    QVERIFY(linesBuffer.open(QIODevice::WriteOnly));
+    lqo::StreamSerializer linesSerializer(&linesBuffer, lqo::StreamSerializer::JsonLines);
+    QVERIFY(linesSerializer.write(items));
+    QVERIFY(linesSerializer.finish());
+
+    const QList<QByteArray> lines = linesBuffer.data().split('\n');
+    QCOMPARE(lines.size(), 101);
+    QVERIFY(lines.last().isEmpty());
+    QCOMPARE(QJsonDocument::fromJson(lines.at(7)).object()[QSL("id")].toString(), QSL("7"));
+
+    QBuffer emptyBuffer;
+    QVERIFY(emptyBuffer.open(QIODevice::WriteOnly));
+    lqo::StreamSerializer emptySerializer(&emptyBuffer);
+    QVERIFY(emptySerializer.finish());
+    QCOMPARE(emptyBuffer.data(), QByteArray("[]"));
+}
+
+void LQObjectSerializerTest::test_case32()
+{
+    if (!lqo::DeflateCodec::isAvailable())
+        QSKIP("Built without zlib");
+
+    QObject parent;
+    QList<Item*> items;
+    for (int i = 0; i < 1000; i++) {
+        Item* item = new Item(&parent);
+        item->setId(QString::number(i));
+        item->setLabel(QSL("label"));
+        items.append(item);
+    }
+
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    lqo::StreamSerializer serializer(&buffer);
+    serializer.setChunkSize(1024);
+    serializer.setCodec(QSharedPointer<lqo::Codec>(new lqo::DeflateCodec(lqo::DeflateCodec::Compress,
+                                                                         lqo::DeflateCodec::Gzip)));
+    QVERIFY(serializer.write(items));
+    QVERIFY(serializer.finish());
+    QCOMPARE(serializer.bytesWritten(), buffer.size());
+
+    lqo::DeflateCodec inflater(lqo::DeflateCodec::Decompress, lqo::DeflateCodec::Gzip);
+    QByteArray json;
+    for (int i = 0; i < buffer.data().size(); i += 100)
+        QVERIFY(inflater.process(buffer.data().constData() + i, qMin(100, int(buffer.data().size() - i)), &json));
+    QVERIFY(inflater.finish(&json));
+    QVERIFY(buffer.size() < json.size());
+    const QJsonArray array = QJsonDocument::fromJson(json).array();
+    QCOMPARE(array.size(), 1000);
+    QCOMPARE(array.at(999).toObject()[QSL("id")].toString(), QSL("999"));
+
+    QFile jsonFile(":/json_3.json");
+    QVERIFY(jsonFile.open(QIODevice::ReadOnly));
+    const QByteArray jsonString = jsonFile.readAll();
+    lqo::DeflateCodec deflater(lqo::DeflateCodec::Compress);
+    QByteArray compressed;
+    QVERIFY(deflater.process(jsonString.constData(), jsonString.size(), &compressed));
+    QVERIFY(deflater.finish(&compressed));
+
+    lqo::IncrementalDeserializer<FPersonInfo> deserializer;
+    deserializer.setCodec(QSharedPointer<lqo::Codec>(new lqo::DeflateCodec(lqo::DeflateCodec::Decompress)));
+    for (int i = 0; i < compressed.size(); i += 16)
+        QVERIFY(deserializer.feed(compressed.mid(i, 16)));
+    QVERIFY(deserializer.isFinished());
+    QCOMPARE(deserializer.object()->name(), QSL("Andrew"));
+
+    deserializer.reset();
+    QVERIFY(!deserializer.feed(jsonString));
+}
+
+void LQObjectSerializerTest::test_case33()
+{
+    QFile jsonFile(":/json_2.json");
+    QVERIFY(jsonFile.open(QIODevice::ReadOnly));
+    const QByteArray jsonString = jsonFile.readAll();
+
+    lqo::Deserializer<MenuRoot> deserializer;
+    QScopedPointer<MenuRoot> first(deserializer.deserialize(jsonString));
+    QScopedPointer<MenuRoot> second(deserializer.deserialize(jsonString));
+
+    lqo::Serializer serializer;
+    const quint64 hash = serializer.hash(first.data());
+    QCOMPARE(serializer.hash(second.data()), hash);
+
+    second->menu()->items().at(3)->setLabel(QSL("Changed"));
+    QVERIFY(serializer.hash(second.data()) != hash);
+    second->menu()->items().at(3)->setLabel(first->menu()->items().at(3)->label());
+    QCOMPARE(serializer.hash(second.data()), hash);
+
+    // Dictionaries do not depend on insertion order.
+    lqo::registerGadgetArray<Sample>();
+    lqo::registerGadgetDictionary<Sample>();
+    SampleSeries a;
+    SampleSeries b;
+    for (int i = 0; i < 50; i++) {
+        Sample sample;
+        sample.t = i;
+        sample.v = i*2;
+        a.m_named.insert(QString::number(i), sample);
+        sample.t = 49 - i;
+        sample.v = (49 - i)*2;
+        b.m_named.insert(QString::number(49 - i), sample);
+    }
+    QCOMPARE(serializer.hash(&a), serializer.hash(&b));
+    b.m_named[QSL("7")].v = 0;
+    QVERIFY(serializer.hash(&a) != serializer.hash(&b));
+}
+
+void LQObjectSerializerTest::test_case34()
+{
+    QFile jsonFile(":/json_2.json");
+    QVERIFY(jsonFile.open(QIODevice::ReadOnly));
+
+    lqo::Deserializer<MenuRoot> deserializer;
+    QScopedPointer<MenuRoot> g(deserializer.deserialize(jsonFile.readAll()));
+    const QList<Item*> items = g->menu()->items();
+    const int objectCount = 2 + items.size() - items.count(nullptr);
+
+    lqo::Serializer serializer;
+    lqo::SerializationCache cache;
+    QCOMPARE(cache.serialize(g.data()), serializer.serialize(g.data()));
+    QCOMPARE(cache.renderCount(), objectCount);
+
+    // Nothing changed: the cached JSON is returned.
+    QCOMPARE(cache.serialize(g.data()), serializer.serialize(g.data()));
+    QCOMPARE(cache.renderCount(), objectCount);
+
+    // Only the item and its ancestors are serialized again.
+    items.at(3)->setLabel(QSL("Changed"));
+    const QJsonObject json = cache.serialize(g.data());
+    QCOMPARE(cache.renderCount(), objectCount + 3);
+    QCOMPARE(json, serializer.serialize(g.data()));
+    QCOMPARE(json[QSL("menu")].toObject()[QSL("items")].toArray().at(3).toObject()[QSL("label")].toString(), QSL("Changed"));
+
+    g->menu()->setHeader(QSL("Header"));
+    QCOMPARE(cache.serialize(g.data()), serializer.serialize(g.data()));
+    QCOMPARE(cache.renderCount(), objectCount + 5);
+
+    // A replaced child no longer invalidates its former parent.
+    Menu* oldMenu = g->menu();
+    g->setMenu(new Menu(g.data()));
+    QCOMPARE(cache.serialize(g.data()), serializer.serialize(g.data()));
+    QCOMPARE(cache.renderCount(), objectCount + 7);
+    oldMenu->setHeader(QSL("Old"));
+    QCOMPARE(cache.serialize(g.data()), serializer.serialize(g.data()));
+    QCOMPARE(cache.renderCount(), objectCount + 7);
+    g->setMenu(oldMenu);
+
+    cache.clear();
+    QCOMPARE(cache.serialize(g.data()), serializer.serialize(g.data()));
+    QCOMPARE(cache.renderCount(), 2*objectCount + 7);
+}
+
+void LQObjectSerializerTest::test_case35()
+{
+    const QByteArray jsonString = QByteArrayLiteral(
+        "{\"header\": \"Header\", \"items\": [{\"id\": \"Open\"}, {\"id\": \"Close\"}]}");
+
+    // Immediate notifications are emitted while the tree is incomplete.
+    Menu immediate;
+    QList<int> itemCounts;
+    connect(&immediate, &Menu::headerChanged, this, [&immediate, &itemCounts] {
+        itemCounts.append(immediate.items().size());
+    });
+    ChildEventRecorder immediateChildren(&immediate);
+    lqo::Deserializer<Menu> deserializer;
+    QVERIFY(deserializer.populate(jsonString, &immediate));
+    QCOMPARE(itemCounts, QList<int>() << 0);
+    QCOMPARE(immediateChildren.itemCounts(), QList<int>() << 0 << 1);
+    QCOMPARE(immediate.items().size(), 2);
+    qDeleteAll(immediate.items());
+
+    // Coalesced notifications are emitted once the tree is complete.
+    Menu coalesced;
+    itemCounts.clear();
+    connect(&coalesced, &Menu::headerChanged, this, [&coalesced, &itemCounts] {
+        itemCounts.append(coalesced.items().size());
+    });
+    QSignalSpy itemsSpy(&coalesced, coalesced.metaObject()->property(coalesced.metaObject()->indexOfProperty("items")).notifySignal());
+    QSignalSpy headerSpy(&coalesced, &Menu::headerChanged);
+    ChildEventRecorder coalescedChildren(&coalesced);
+    QList<int> replacedCounts;
+    deserializer.setTreeReplacedHandler([&coalesced, &replacedCounts] (Menu* menu) {
+        QCOMPARE(menu, &coalesced);
+        replacedCounts.append(menu->items().size());
+    });
+    deserializer.setNotificationMode(lqo::CoalescedNotifications);
+    QVERIFY(deserializer.populate(jsonString, &coalesced));
+    QCOMPARE(itemCounts, QList<int>() << 2);
+    QCOMPARE(itemsSpy.count(), 1);
+    QCOMPARE(headerSpy.count(), 1);
+    QCOMPARE(headerSpy.at(0).at(0).toString(), QSL("Header"));
+    // Children are parented, and ChildAdded delivered, only when the tree is complete.
+    QCOMPARE(coalescedChildren.itemCounts(), QList<int>() << 2 << 2);
+    QCOMPARE(coalesced.items().at(0)->parent(), &coalesced);
+    QCOMPARE(replacedCounts, QList<int>() << 2);
+    QVERIFY(!coalesced.signalsBlocked());
+    QCOMPARE(coalesced.items().at(1)->id(), QSL("Close"));
+    qDeleteAll(coalesced.items());
+    deserializer.setTreeReplacedHandler(nullptr);
+
+    Menu silent;
+    QSignalSpy silentSpy(&silent, silent.metaObject()->property(silent.metaObject()->indexOfProperty("header")).notifySignal());
+    deserializer.setNotificationMode(lqo::NoNotifications);
+    QVERIFY(deserializer.populate(jsonString, &silent));
+    QCOMPARE(silentSpy.count(), 0);
+    QCOMPARE(silent.header(), QSL("Header"));
+    QVERIFY(!silent.signalsBlocked());
+    qDeleteAll(silent.items());
+}
+
+void LQObjectSerializerTest::test_case36()
+{
+    qRegisterMetaType<Shape*>();
+    lqo::registerPolymorphic<Shape, Circle>(QSL("kind"), QSL("circle"));
+    lqo::registerPolymorphic<Shape, Rect>(QSL("kind"), QSL("rect"));
+
+    const QByteArray jsonString = QByteArrayLiteral(
+        "{\"background\": {\"kind\": \"rect\", \"name\": \"bg\", \"w\": 3, \"h\": 4}, "
+        "\"shapes\": [{\"kind\": \"circle\", \"radius\": 2.5}, {\"kind\": \"rect\", \"w\": 1}, "
+        "{\"name\": \"plain\"}, null, {\"kind\": \"hexagon\"}]}");
+
+    lqo::Deserializer<Drawing> deserializer;
+    QScopedPointer<Drawing> drawing(deserializer.deserialize(jsonString));
+    QVERIFY(drawing);
+
+    Rect* background = qobject_cast<Rect*>(drawing->background());
+    QVERIFY(background);
+    QCOMPARE(background->name(), QSL("bg"));
+    QCOMPARE(background->h(), 4);
+
+    const QList<Shape*> shapes = drawing->shapes();
+    QCOMPARE(shapes.size(), 5);
+    QVERIFY(qobject_cast<Circle*>(shapes.at(0)));
+    QCOMPARE(qobject_cast<Circle*>(shapes.at(0))->radius(), 2.5);
+    QCOMPARE(qobject_cast<Rect*>(shapes.at(1))->w(), 1);
+    QCOMPARE(shapes.at(2)->metaObject(), &Shape::staticMetaObject);
+    QCOMPARE(shapes.at(2)->name(), QSL("plain"));
+    QVERIFY(!shapes.at(3));
+    QVERIFY(!shapes.at(4));
+
+    // Unknown discriminators are reported and the element is kept as nullptr.
+    QCOMPARE(deserializer.errors().size(), 1);
+    QCOMPARE(deserializer.errors().first().code, lqo::Error::UnknownType);
+    QCOMPARE(deserializer.errors().first().path, QSL("shapes[4]"));
+
+    // Top level arrays select the subtype the same way.
+    lqo::Deserializer<Shape> shapeDeserializer;
+    const QList<Shape*> topLevel = shapeDeserializer.deserializeObjectArray(QJsonDocument::fromJson(
+        "[{\"kind\": \"circle\", \"radius\": 1}, null, {\"kind\": \"hexagon\"}]").array());
+    QCOMPARE(topLevel.size(), 3);
+    QCOMPARE(qobject_cast<Circle*>(topLevel.at(0))->radius(), 1.0);
+    QVERIFY(!topLevel.at(1));
+    QVERIFY(!topLevel.at(2));
+    QCOMPARE(shapeDeserializer.errors().size(), 1);
+    QCOMPARE(shapeDeserializer.errors().first().path, QSL("[2]"));
+    qDeleteAll(topLevel);
+
+    lqo::Serializer serializer;
+    const QJsonObject json = serializer.serialize(drawing.data());
+    QCOMPARE(json[QSL("background")].toObject()[QSL("kind")].toString(), QSL("rect"));
+    const QJsonArray array = json[QSL("shapes")].toArray();
+    QCOMPARE(array.at(0).toObject()[QSL("kind")].toString(), QSL("circle"));
+    QCOMPARE(array.at(0).toObject()[QSL("radius")].toDouble(), 2.5);
+    QVERIFY(!array.at(2).toObject().contains(QSL("kind")));
+
+    QJsonObject roundTrip = QJsonDocument::fromJson(serializer.serializeToJson(drawing.data())).object();
+    QCOMPARE(roundTrip, json);
+
+    // The cache writes the discriminator as well.
+    lqo::SerializationCache cache;
+    QCOMPARE(cache.serialize(drawing.data()), json);
+    qobject_cast<Circle*>(shapes.at(0))->set_radius(3);
+    QCOMPARE(cache.serialize(drawing.data()), serializer.serialize(drawing.data()));
+
+    QVERIFY(!deserializer.validate(jsonString));
+    QCOMPARE(deserializer.errors().size(), 1);
+    QVERIFY(deserializer.validate(QJsonDocument(json).toJson()));
+}
+
+void LQObjectSerializerTest::test_case37()
+{
+    QFile jsonFile(":/json_2.json");
+    QVERIFY(jsonFile.open(QIODevice::ReadOnly));
+    const QByteArray menuJson = jsonFile.readAll();
+
+    auto exceeded = [] (const QVector<lqo::Error>& errors) -> QString {
+        if (errors.size() != 1 || errors.first().code != lqo::Error::LimitExceeded)
+            return QString();
+        return errors.first().property;
+    };
+
+    lqo::Limits limits;
+    limits.maxDepth = 32;
+    limits.maxArrayLength = 1000;
+    limits.maxObjects = 100;
+    limits.maxStringBytes = 4096;
+    limits.maxInputBytes = 1024*1024;
+
+    lqo::Deserializer<MenuRoot> menuDeserializer;
+    menuDeserializer.setLimits(limits);
+    QScopedPointer<MenuRoot> menu(menuDeserializer.deserialize(menuJson));
+    QVERIFY(menu);
+    QVERIFY(menuDeserializer.errors().isEmpty());
+
+    // Pathological documents are rejected before they are parsed: the unbalanced
+    // brackets would otherwise be a parse error.
+    QVERIFY(!menuDeserializer.deserialize(QByteArrayLiteral("{\"menu\": ") + QByteArray(100000, '[')));
+    QCOMPARE(exceeded(menuDeserializer.errors()), QSL("maxDepth"));
+
+    QByteArray longArray = QByteArrayLiteral("{\"identifiers\": [0");
+    for (int i = 0; i < 100000; i++)
+        longArray.append(",0");
+    lqo::Deserializer<FPersonInfo> personDeserializer;
+    personDeserializer.setLimits(limits);
+    QVERIFY(!personDeserializer.deserialize(longArray));
+    QCOMPARE(exceeded(personDeserializer.errors()), QSL("maxArrayLength"));
+
+    QVERIFY(!personDeserializer.deserialize(QByteArrayLiteral("{\"name\": \"") + QByteArray(5000, 'a') + "\"}"));
+    QCOMPARE(exceeded(personDeserializer.errors()), QSL("maxStringBytes"));
+
+    limits.maxObjects = 5;
+    menuDeserializer.setLimits(limits);
+    QVERIFY(!menuDeserializer.deserialize(menuJson));
+    QCOMPARE(exceeded(menuDeserializer.errors()), QSL("maxObjects"));
+
+    limits.maxInputBytes = 64;
+    menuDeserializer.setLimits(limits);
+    QVERIFY(!menuDeserializer.deserialize(menuJson));
+    QCOMPARE(exceeded(menuDeserializer.errors()), QSL("maxInputBytes"));
+
+    // Documents that are already parsed are checked before they are deserialized.
+    QJsonObject deep;
+    for (int i = 0; i < 1000; i++) {
+        QJsonObject parent;
+        parent[QSL("child")] = deep;
+        deep = parent;
+    }
+    qRegisterMetaType<Node*>();
+    lqo::Deserializer<Node> nodeDeserializer;
+    limits.maxInputBytes = -1;
+    nodeDeserializer.setLimits(limits);
+    QVERIFY(!nodeDeserializer.deserialize(deep));
+    QCOMPARE(exceeded(nodeDeserializer.errors()), QSL("maxObjects"));
+    limits.maxObjects = -1;
+    nodeDeserializer.setLimits(limits);
+    QVERIFY(!nodeDeserializer.deserialize(deep));
+    QCOMPARE(exceeded(nodeDeserializer.errors()), QSL("maxDepth"));
+
+    lqo::IncrementalDeserializer<MenuRoot> incremental;
+    limits.maxInputBytes = 256;
+    incremental.setLimits(limits);
+    bool failed = false;
+    for (int i = 0; i < menuJson.size() && !failed; i += 64)
+        failed = !incremental.feed(menuJson.mid(i, 64));
+    QVERIFY(failed);
+    QCOMPARE(incremental.errorString(), QSL("maxInputBytes exceeded"));
+
+    // Limits mean the same on every path: strings are measured in UTF-8 bytes, keys
+    // included, and arrays count toward the depth.
+    lqo::Limits stringLimits;
+    stringLimits.maxStringBytes = 12;
+    personDeserializer.setLimits(stringLimits);
+    // Returns the limit exceeded by bytes, by a parsed document and by incremental input.
+    auto checkPerson = [&] (const QByteArray& json) -> QStringList {
+        QStringList ret;
+        QScopedPointer<FPersonInfo> person(personDeserializer.deserialize(json));
+        ret.append(exceeded(personDeserializer.errors()));
+        QScopedPointer<FPersonInfo> parsed(personDeserializer.deserialize(QJsonDocument::fromJson(json).object()));
+        ret.append(exceeded(personDeserializer.errors()));
+
+        lqo::IncrementalDeserializer<FPersonInfo> incrementalPerson;
+        incrementalPerson.setLimits(personDeserializer.limits());
+        for (int i = 0; i < json.size() && !incrementalPerson.hasError(); i++)
+            incrementalPerson.feed(json.mid(i, 1));
+        ret.append(incrementalPerson.hasError() ? incrementalPerson.errorString().section(QLatin1Char(' '), 0, 0) : QString());
+        return ret;
+    };
+    auto onEveryPath = [] (const QString& limit) { return QStringList() << limit << limit << limit; };
+    QCOMPARE(checkPerson("{\"name\": \"abcde\"}"), onEveryPath(QString()));
+    QCOMPARE(checkPerson("{\"name\": \"\xc3\xa8\xc3\xa8\xc3\xa8\xc3\xa8\xc3\xa8\"}"), onEveryPath(QSL("maxStringBytes")));
+    QCOMPARE(checkPerson("{\"name\": \"\\u00e8\\u00e8\\u00e8\\u00e8\\u00e8\"}"), onEveryPath(QSL("maxStringBytes")));
+
+    lqo::Limits depthLimits;
+    depthLimits.maxDepth = 4;
+    personDeserializer.setLimits(depthLimits);
+    QCOMPARE(checkPerson("{\"identifiers\": [1, 2]}"), onEveryPath(QString()));
+    QCOMPARE(checkPerson("{\"identifiers\": [[[[1]]]]}"), onEveryPath(QSL("maxDepth")));
+
+    // Array lengths count elements, so a single element exceeds a limit of 0.
+    lqo::Limits lengthLimits;
+    lengthLimits.maxArrayLength = 0;
+    personDeserializer.setLimits(lengthLimits);
+    QCOMPARE(checkPerson("{\"identifiers\": []}"), onEveryPath(QString()));
+    QCOMPARE(checkPerson("{\"identifiers\": [ ]}"), onEveryPath(QString()));
+    QCOMPARE(checkPerson("{\"identifiers\": [1]}"), onEveryPath(QSL("maxArrayLength")));
+    lengthLimits.maxArrayLength = 2;
+    personDeserializer.setLimits(lengthLimits);
+    QCOMPARE(checkPerson("{\"identifiers\": [1, 2]}"), onEveryPath(QString()));
+    QCOMPARE(checkPerson("{\"identifiers\": [1, 2, 3]}"), onEveryPath(QSL("maxArrayLength")));
+}
+
+void LQObjectSerializerTest::test_case38()
+{
+    QFile jsonFile(":/json_2.json");
+    QVERIFY(jsonFile.open(QIODevice::ReadOnly));
+
+    lqo::Deserializer<MenuRoot> deserializer;
+    deserializer.setMemoryAccounting(true);
+    QScopedPointer<MenuRoot> menu(deserializer.deserialize(jsonFile.readAll()));
+    QVERIFY(menu);
+
+    int items = 0;
+    for (const Item* item : menu->menu()->items())
+        if (item)
+            items++;
+
+    const lqo::MemoryReport report = lqo::memoryUsage(menu.data());
+    QCOMPARE(report.types.value(&MenuRoot::staticMetaObject).instances, qint64(1));
+    QCOMPARE(report.types.value(&Menu::staticMetaObject).instances, qint64(1));
+    QCOMPARE(report.types.value(&Item::staticMetaObject).instances, qint64(items));
+    QVERIFY(report.types.value(&Item::staticMetaObject).objectBytes >= items*qint64(sizeof(QObject)));
+    QVERIFY(report.types.value(&Item::staticMetaObject).stringBytes > 0);
+    QVERIFY(report.types.value(&Menu::staticMetaObject).containerBytes > 0);
+    QCOMPARE(report.total().instances, qint64(items + 2));
+
+    // The report collected while deserializing accounts the same objects.
+    const lqo::MemoryReport collected = deserializer.memoryReport();
+    QCOMPARE(collected.types.value(&MenuRoot::staticMetaObject).instances, qint64(1));
+    QCOMPARE(collected.types.value(&Menu::staticMetaObject).instances, qint64(1));
+    QCOMPARE(collected.types.value(&Item::staticMetaObject).instances, qint64(items));
+    QCOMPARE(collected.types.value(&Item::staticMetaObject).objectBytes,
+             report.types.value(&Item::staticMetaObject).objectBytes);
+    QVERIFY(collected.total().stringBytes > 0);
+    QVERIFY(collected == report);
+
+    // Values stored through kernels are measured, and counted, the same way on both paths.
+    lqo::registerGadgetArray<Sample>();
+    lqo::registerGadgetDictionary<Sample>();
+    lqo::Deserializer<SampleSeries> seriesDeserializer;
+    seriesDeserializer.setMemoryAccounting(true);
+    QScopedPointer<SampleSeries> series(seriesDeserializer.deserialize(QByteArrayLiteral(
+            "{\"samples\": [{\"t\": 1, \"v\": 2}, {\"t\": 3, \"v\": 4}], \"named\": {\"a\": {\"t\": 5, \"v\": 6}}}")));
+    QVERIFY(series);
+    const lqo::MemoryReport seriesReport = lqo::memoryUsage(series.data());
+    QCOMPARE(seriesReport.types.value(&Sample::staticMetaObject).instances, qint64(3));
+    QVERIFY(seriesReport.types.value(&SampleSeries::staticMetaObject).containerBytes >= 3*qint64(sizeof(Sample)));
+    QVERIFY(seriesDeserializer.memoryReport() == seriesReport);
+
+    lqo::Deserializer<HashTest> hashDeserializer;
+    hashDeserializer.setMemoryAccounting(true);
+    QScopedPointer<HashTest> hash(hashDeserializer.deserialize(QByteArrayLiteral(
+            "{\"test1\": {\"a\": 1}, \"test3\": {\"x\": {\"objectName\": \"X\"}}}")));
+    QVERIFY(hash);
+    const lqo::MemoryReport hashReport = lqo::memoryUsage(hash.data());
+    QCOMPARE(hashReport.types.value(&QObject::staticMetaObject).instances, qint64(1));
+    QVERIFY(hashReport.types.value(&HashTest::staticMetaObject).containerBytes > 0);
+    QVERIFY(hashDeserializer.memoryReport() == hashReport);
+    qDeleteAll(hash->test3());
+
+    lqo::registerColumnar<Item>();
+    lqo::Deserializer<ColumnarMenu> columnarDeserializer;
+    columnarDeserializer.setMemoryAccounting(true);
+    jsonFile.seek(0);
+    const QJsonObject menuJson = QJsonDocument::fromJson(jsonFile.readAll()).object()[QSL("menu")].toObject();
+    QScopedPointer<ColumnarMenu> columnar(columnarDeserializer.deserialize(menuJson));
+    QVERIFY(columnar);
+    const lqo::MemoryReport columnarReport = lqo::memoryUsage(columnar.data());
+    QVERIFY(columnarReport.types.value(&ColumnarMenu::staticMetaObject).containerBytes > 0);
+    QVERIFY(columnarReport.types.value(&ColumnarMenu::staticMetaObject).stringBytes > 0);
+    QVERIFY(columnarDeserializer.memoryReport() == columnarReport);
+
+    QScopedPointer<MenuRoot> empty(new MenuRoot);
+    QCOMPARE(lqo::memoryUsage(empty.data()).total().instances, qint64(1));
+
+    // RawJson is measured from its bytes or from its parsed value.
+    RawTest raw;
+    raw.setExtensions(lqo::RawJson::fromJson("{\"cached\": [1, 2]}"));
+    QVERIFY(lqo::memoryUsage(&raw).types.value(&RawTest::staticMetaObject).otherBytes > 18);
+    raw.setExtensions(lqo::RawJson(QJsonDocument::fromJson("{\"cached\": [1, 2]}").object()));
+    QVERIFY(lqo::memoryUsage(&raw).types.value(&RawTest::staticMetaObject).otherBytes > 0);
+}
+
+void LQObjectSerializerTest::test_case39()
+{
+    const QByteArray json = QByteArrayLiteral("{\"id\": \"9f86d081884c7d65\", "
+                                              "\"url\": \"https://example.com/a?b=c&d=\\u00e8\", "
+                                              "\"title\": \"Caf\xc3\xa9 \\\"Z\\\"\\n\"}");
+
+    lqo::Deserializer<Link> deserializer;
+    QScopedPointer<Link> link(deserializer.deserialize(json));
+    QVERIFY(link);
+    QVERIFY(deserializer.errors().isEmpty());
+    QCOMPARE(link->id(), QByteArray("9f86d081884c7d65"));
+    QCOMPARE(link->url(), QByteArray("https://example.com/a?b=c&d=\xc3\xa8"));
+    QCOMPARE(link->title(), QByteArray("Caf\xc3\xa9 \"Z\"\n"));
+
+    // The incremental deserializer reads the strings of QByteArray members directly.
+    lqo::IncrementalDeserializer<Link> incremental;
+    for (int i = 0; i < json.size(); i += 7)
+        QVERIFY(incremental.feed(json.mid(i, 7)));
+    QVERIFY(incremental.isFinished());
+    QCOMPARE(incremental.object()->id(), link->id());
+    QCOMPARE(incremental.object()->url(), link->url());
+    QCOMPARE(incremental.object()->title(), link->title());
+
+    // UTF-8 is written verbatim; only quotes, backslashes and control characters are escaped.
+    lqo::Serializer serializer;
+    QCOMPARE(serializer.serializeToJson(link.data()),
+             QByteArray("{\"id\":\"9f86d081884c7d65\","
+                        "\"url\":\"https://example.com/a?b=c&d=\xc3\xa8\","
+                        "\"title\":\"Caf\xc3\xa9 \\\"Z\\\"\\n\"}"));
+    QCOMPARE(QJsonDocument::fromJson(serializer.serializeToJson(link.data())).object(), serializer.serialize(link.data()));
+    QCOMPARE(serializer.serialize(link.data()).value(QSL("title")).toString(), QString::fromUtf8("Caf\xc3\xa9 \"Z\"\n"));
+
+    link->setUrl(QByteArray());
+    QVERIFY(!serializer.serialize(link.data()).contains(QSL("url")));
+    QVERIFY(!serializer.serializeToJson(link.data()).contains("url"));
+
+    // Invalid UTF-8 is not copied: bad sequences become U+FFFD, as with QString.
+    link->setId(QByteArray("ab\xff\xc3"));
+    link->setTitle(QByteArray("\xc0\xaf\xed\xa0\x80"));
+    QJsonParseError error;
+    const QJsonObject invalid = QJsonDocument::fromJson(serializer.serializeToJson(link.data()), &error).object();
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(invalid.value(QSL("id")).toString(), QString::fromUtf8("ab\xff\xc3"));
+    QCOMPARE(invalid.value(QSL("title")).toString(), QString::fromUtf8("\xc0\xaf\xed\xa0\x80"));
+    QVERIFY(invalid.value(QSL("id")).toString().contains(QChar(0xfffd)));
+}
+
 QTEST_GUILESS_MAIN(LQObjectSerializerTest)
 
 #include "tst_lqobjectserializertest.moc"